@@ -0,0 +1,48 @@
+// Example for the sw::bench harness: benchmarks sorting and summing for a range of input sizes.
+// Usage: bench_example [table|csv|json]
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string_view>
+#include <vector>
+#include <stopwatch/bench.hpp>
+
+int main(int argc, char** argv)
+{
+    const std::string_view format = argc > 1 ? argv[1] : "table";
+    const std::vector<std::int64_t> sizes = {1000, 10000, 100000};
+
+    sw::bench::config config;
+    config.samples = 20;
+    sw::bench::runner runner(config);
+
+    std::mt19937 rng(42);
+    std::vector<std::uint32_t> input(static_cast<std::size_t>(sizes.back()));
+    std::generate(input.begin(), input.end(), rng);
+    std::vector<std::uint32_t> scratch;
+
+    runner.run("sort", sizes, [&](std::int64_t n)
+    {
+        scratch.assign(input.begin(), input.begin() + n);
+        std::sort(scratch.begin(), scratch.end());
+        sw::bench::do_not_optimize(scratch.data());
+    });
+    runner.run("accumulate", sizes, [&](std::int64_t n)
+    {
+        sw::bench::do_not_optimize(std::accumulate(input.begin(), input.begin() + n, std::uint64_t{0}));
+    });
+    runner.run("steady_clock::now", []()
+    {
+        sw::bench::do_not_optimize(std::chrono::steady_clock::now());
+    });
+
+    if (format == "csv")
+        runner.write_csv(std::cout);
+    else if (format == "json")
+        runner.write_json(std::cout);
+    else
+        runner.report(std::cout);
+    return 0;
+}
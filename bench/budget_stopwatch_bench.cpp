@@ -0,0 +1,85 @@
+// Cost of checking a budget on the hot path, within budget and on overrun with a deferred callback, compared to
+// reporting synchronously, and the aggregate of a stage that misses its budget every fourth call.
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <stopwatch/bench.hpp>
+#include <stopwatch/budget_stopwatch.hpp>
+
+namespace
+{
+    std::atomic<std::uint64_t> callbacks{0};
+
+    void count_overrun(const sw::budget_overrun&)
+    {
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void spin(std::chrono::microseconds duration)
+    {
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + duration;
+        std::uint64_t iterations = 0;
+        while (std::chrono::steady_clock::now() < end)
+            ++iterations;
+        sw::bench::do_not_optimize(iterations);
+    }
+}
+
+int main()
+{
+    sw::budget_stats stats;
+    sw::bench::runner runner;
+    runner.run("stopwatch start/stop", []()
+    {
+        sw::hres_stopwatch_us s;
+        s.start();
+        s.stop();
+        sw::bench::do_not_optimize(s.elapsed_clock());
+    });
+    runner.run("budget check within budget", [&stats]()
+    {
+        sw::hres_budget_stopwatch_us s(std::chrono::seconds(1), "stage: ", &stats, &count_overrun);
+        s.start();
+        sw::bench::do_not_optimize(s.check());
+    });
+    // every check overruns and queues a callback; the queue is drained well before it fills up, so that the
+    // timing covers the queued path plus the amortized callbacks rather than the cheaper lost path
+    sw::budget_overrun_dispatcher& dispatcher = sw::budget_overrun_dispatcher::instance();
+    const std::uint64_t overruns_before = stats.snapshot().overruns;
+    const std::uint64_t lost_before = dispatcher.lost();
+    runner.run("budget check on overrun, deferred callback", [&stats, &dispatcher, checks = std::uint64_t{0}]() mutable
+    {
+        sw::hres_budget_stopwatch_us s(std::chrono::nanoseconds(0), "stage: ", &stats, &count_overrun);
+        s.start();
+        sw::bench::do_not_optimize(s.check());
+        if (++checks % 256 == 0)
+            dispatcher.flush();
+    });
+    const std::uint64_t overruns = stats.snapshot().overruns - overruns_before;
+    const std::uint64_t lost = dispatcher.lost() - lost_before;
+    runner.run("stop and report_elapsed to a stream", []()
+    {
+        static std::ostringstream out;
+        sw::hres_auto_stopwatch_us s("stage: ");
+        s.stop();
+        s.report_elapsed(out);
+        out.str({});
+    });
+    runner.report(std::cout);
+    dispatcher.flush();
+    std::cout << "deferred callback: overruns " << overruns << ", lost " << lost << " ("
+              << (overruns != 0 ? 100.0 * static_cast<double>(lost) / static_cast<double>(overruns) : 0.0)
+              << " %), callbacks " << callbacks.load() << "\n\n";
+
+    stats.reset();
+    for (int i = 0; i < 200; ++i)
+    {
+        sw::hres_scoped_budget_stopwatch_us s(std::chrono::microseconds(200), "stage: ", &stats);
+        spin(std::chrono::microseconds(i % 4 == 0 ? 300 : 50));
+    }
+    stats.snapshot().report(std::cout, "stage with a 200 us budget: ");
+    return 0;
+}
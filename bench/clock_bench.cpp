@@ -0,0 +1,48 @@
+// Compares the cost of now() and the resolution of all clocks, including the runtime dispatched sw::any_clock.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <stopwatch/any_clock.hpp>
+#include <stopwatch/calibration.hpp>
+
+namespace
+{
+    template <typename clock_type>
+    void report_system_resolution(const char* name)
+    {
+        char buffer[sw::max_duration_str_length];
+        const char* const end = sw::format_duration(buffer, sw::as<sw::nanoseconds_d>(clock_type::resolution()));
+        std::cout << name << std::string_view(buffer, static_cast<std::size_t>(end - buffer)) << '\n';
+    }
+}
+
+int main()
+{
+    std::cout << "measured now() cost and resolution:\n";
+    sw::report_clock_calibrations(std::cout);
+    sw::clock_calibration_of<sw::thread_cpu_clock>().report(std::cout, "thread_cpu_clock: ");
+
+    std::cout << "\nresolution reported by clock_getres:\n";
+#if STOPWATCH_HAS_MONOTONIC_COARSE_CLOCK
+    report_system_resolution<sw::monotonic_coarse_clock>("monotonic_coarse_clock: ");
+#endif
+#if STOPWATCH_HAS_MONOTONIC_RAW_CLOCK
+    report_system_resolution<sw::monotonic_raw_clock>("monotonic_raw_clock: ");
+#endif
+#if STOPWATCH_HAS_BOOTTIME_CLOCK
+    report_system_resolution<sw::boottime_clock>("boottime_clock: ");
+#endif
+
+    // the selection is fixed by the first call to now(), so it has to happen before calibrating any_clock
+    sw::any_clock::select_cheapest();
+    std::cout << "\nany_clock candidates, selection marked with '*':\n";
+    sw::any_clock::report(std::cout);
+    sw::calibrate_clock<sw::any_clock>().report(std::cout, "any_clock dispatch: ");
+
+    // a coarse clock qualifies once the required resolution is relaxed
+    const sw::clock_candidate& coarse = sw::any_clock::candidates()[static_cast<std::size_t>(sw::any_clock::cheapest(std::chrono::milliseconds(10)))];
+    std::cout << "\ncheapest clock with 10 ms resolution: " << coarse.name << '\n';
+    coarse.calibration().report(std::cout, std::string(coarse.name).append(": "));
+    return 0;
+}
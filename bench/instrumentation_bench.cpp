@@ -0,0 +1,64 @@
+// Cost of instrumenting a hot function: uninstrumented, timed every call, and timed in 1 of N calls.
+// Built twice, as instrumentation_bench and as instrumentation_bench_disabled with STOPWATCH_DISABLE defined,
+// where the instrumented variants must match the uninstrumented one.
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <stopwatch/bench.hpp>
+#include <stopwatch/registry.hpp>
+
+namespace
+{
+    std::array<std::uint32_t, 64> input = {};
+
+    // the hot function, a few dozen nanoseconds of work
+    inline std::uint32_t work()
+    {
+        std::uint32_t h = 2166136261u;
+        for (const std::uint32_t v : input)
+            h = (h ^ v) * 16777619u;
+        return h;
+    }
+
+    std::uint32_t uninstrumented()
+    {
+        return work();
+    }
+
+    std::uint32_t scoped_timer()
+    {
+        STOPWATCH_SCOPED_TIMER("scoped timer");
+        return work();
+    }
+
+    std::uint32_t sampled_timer_64()
+    {
+        STOPWATCH_SAMPLED_TIMER("sampled timer 1/64", 64);
+        return work();
+    }
+
+    std::uint32_t sampled_timer_1024()
+    {
+        STOPWATCH_SAMPLED_TIMER("sampled timer 1/1024", 1024);
+        return work();
+    }
+}
+
+int main()
+{
+    for (std::size_t i = 0; i < input.size(); ++i)
+        input[i] = static_cast<std::uint32_t>(i * 2654435761u);
+
+    std::cout << (sw::stopwatch_enabled ? "stopwatches enabled\n" : "stopwatches disabled (STOPWATCH_DISABLE)\n");
+    sw::bench::runner runner;
+    runner.run("uninstrumented", []() { sw::bench::do_not_optimize(uninstrumented()); });
+    runner.run("scoped timer", []() { sw::bench::do_not_optimize(scoped_timer()); });
+    runner.run("sampled timer 1/64", []() { sw::bench::do_not_optimize(sampled_timer_64()); });
+    runner.run("sampled timer 1/1024", []() { sw::bench::do_not_optimize(sampled_timer_1024()); });
+    runner.report(std::cout);
+
+    // sampled timers estimate the call count and total time of timing every call
+    std::cout << "\nregistry:\n";
+    sw::timer_registry::instance().snapshot().print(std::cout);
+    return 0;
+}
@@ -0,0 +1,56 @@
+// Cost of a composite wall/process cpu/thread cpu stopwatch compared to three separate stopwatches, and its metrics
+// for a section that computes on two threads and then sleeps.
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <stopwatch/bench.hpp>
+#include <stopwatch/multi_stopwatch.hpp>
+
+namespace
+{
+    void spin(std::chrono::milliseconds duration)
+    {
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + duration;
+        std::uint64_t iterations = 0;
+        while (std::chrono::steady_clock::now() < end)
+            ++iterations;
+        sw::bench::do_not_optimize(iterations);
+    }
+}
+
+int main()
+{
+    sw::bench::runner runner;
+    runner.run("multi stopwatch start/stop", []()
+    {
+        sw::hres_multi_stopwatch_us s;
+        s.start();
+        s.stop();
+        sw::bench::do_not_optimize(s.elapsed_clock<0>());
+    });
+    runner.run("three stopwatches start/stop", []()
+    {
+        sw::hres_stopwatch_us wall;
+        sw::basic_stopwatch<sw::cpu_clock, sw::microseconds_d, false, false> process;
+        sw::basic_stopwatch<sw::thread_cpu_clock, sw::microseconds_d, false, false> thread;
+        wall.start();
+        process.start();
+        thread.start();
+        thread.stop();
+        process.stop();
+        wall.stop();
+        sw::bench::do_not_optimize(wall.elapsed_clock());
+    });
+    runner.report(std::cout);
+
+    sw::hres_multi_stopwatch_ms s("two threads for 50 ms, then sleep for 50 ms: ");
+    s.start();
+    std::thread worker([]() { spin(std::chrono::milliseconds(50)); });
+    spin(std::chrono::milliseconds(50));
+    worker.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    s.stop();
+    s.report_elapsed(std::cout);
+    return 0;
+}
@@ -0,0 +1,46 @@
+// Cost of reading the perf event group and of a perf stopwatch start/stop pair, and the counters of a sample workload.
+// Without permission to open perf events (perf_event_paranoid, containers, vms without pmu) only time is reported.
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include <stopwatch/bench.hpp>
+#include <stopwatch/perf_stopwatch.hpp>
+
+int main()
+{
+    const sw::perf_event_group& group = sw::perf_event_group::thread_group();
+    std::cout << "perf events available: " << group.available() << ", rdpmc: " << group.uses_rdpmc()
+              << ", first open error: " << group.error() << '\n';
+
+    sw::bench::runner runner;
+    runner.run("perf_event_group::read", [&]()
+    {
+        sw::bench::do_not_optimize(group.read());
+    });
+    runner.run("hres_perf_stopwatch start/stop", []()
+    {
+        sw::hres_perf_stopwatch_ns s;
+        s.start();
+        s.stop();
+        sw::bench::do_not_optimize(s.counters());
+    });
+    runner.report(std::cout);
+
+    // strided accesses miss the cache far more often than sequential ones
+    std::vector<std::uint32_t> data(std::size_t{1} << 24, 1);
+    for (const std::size_t stride : {std::size_t{1}, std::size_t{16}})
+    {
+        sw::hres_perf_stopwatch_us s(stride == 1 ? "sequential sum " : "strided sum ");
+        s.start();
+        std::uint64_t sum = 0;
+        for (std::size_t offset = 0; offset < stride; ++offset)
+        {
+            for (std::size_t i = offset; i < data.size(); i += stride)
+                sum += data[i];
+        }
+        s.stop();
+        sw::bench::do_not_optimize(sum);
+        s.report_elapsed(std::cout);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Aggregate recording throughput of a rate_meter with 1 to 64 producer threads, compared to a single shared
+// atomic counter, followed by the rates of a producer that doubles its rate every half second.
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <stopwatch/rate_meter.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+namespace
+{
+    constexpr std::size_t iterations = 1000000;
+
+    // runs body on thread_count threads and returns million calls per second
+    template <typename fn>
+    double throughput(std::size_t thread_count, fn body)
+    {
+        std::vector<std::thread> threads;
+        sw::hres_stopwatch_s run;
+        run.start();
+        for (std::size_t t = 0; t < thread_count; ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                for (std::size_t i = 0; i < iterations; ++i)
+                    body();
+            });
+        }
+        for (std::thread& t : threads)
+            t.join();
+        run.stop();
+        return static_cast<double>(thread_count * iterations) / run.elapsed().count() / 1.0e6;
+    }
+}
+
+int main()
+{
+    std::cout << "threads, rate_meter million records per second, shared atomic million increments per second\n";
+    for (std::size_t thread_count = 1; thread_count <= 64; thread_count *= 2)
+    {
+        sw::rate_meter meter;
+        alignas(64) std::atomic<std::uint64_t> shared{0};
+        const double sharded = throughput(thread_count, [&]() { meter.record(1, 64); });
+        const double single = throughput(thread_count, [&]() { shared.fetch_add(1, std::memory_order_relaxed); });
+        std::cout << thread_count << ", " << sharded << ", " << single
+                  << (meter.total_items() == thread_count * iterations ? "" : " (items lost)") << "\n";
+    }
+
+    sw::rate_meter meter(std::chrono::milliseconds(500));
+    std::atomic<bool> stop{false};
+    std::thread producer([&]()
+    {
+        // 1000, 2000, 4000 and 8000 items per second, half a second each
+        for (int step = 0; step < 4 && !stop.load(); ++step)
+        {
+            const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+            const std::chrono::microseconds interval(1000000 / (1000 << step));
+            for (std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now(); next < end; next += interval)
+            {
+                std::this_thread::sleep_until(next);
+                meter.record(1, 512);
+            }
+        }
+    });
+    for (int i = 0; i < 20; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (i % 5 == 4)
+            meter.snapshot().report(std::cout, "producer ");
+        else
+            meter.snapshot();
+    }
+    stop = true;
+    producer.join();
+    return 0;
+}
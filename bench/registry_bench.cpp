@@ -0,0 +1,69 @@
+// Measures the aggregate recording throughput of registry timers with 1 to 64 recording threads, and the
+// cost of merging all thread slots in timer_registry::snapshot() while the threads are still alive.
+// Without contention the throughput scales with the number of threads up to the number of cores.
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <stopwatch/registry.hpp>
+
+namespace
+{
+    constexpr std::size_t iterations = 200000;
+    constexpr std::size_t snapshot_repetitions = 100;
+
+    void record_sections()
+    {
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            STOPWATCH_SCOPED_TIMER("bench/outer");
+            {
+                STOPWATCH_SCOPED_TIMER("bench/inner");
+            }
+        }
+    }
+}
+
+int main()
+{
+    std::cout << "threads, million timers per second, snapshot us\n";
+    for (std::size_t thread_count = 1; thread_count <= 64; thread_count *= 2)
+    {
+        std::atomic<std::size_t> done{0};
+        std::atomic<bool> release{false};
+        std::vector<std::thread> threads;
+        sw::hres_stopwatch_s run;
+        run.start();
+        for (std::size_t t = 0; t < thread_count; ++t)
+        {
+            threads.emplace_back([&]()
+            {
+                record_sections();
+                ++done;
+                // stay alive so that snapshot() has to merge this thread's slots
+                while (!release.load())
+                    std::this_thread::yield();
+            });
+        }
+        while (done.load() != thread_count)
+            std::this_thread::yield();
+        run.stop();
+
+        sw::hres_stopwatch_us merge;
+        merge.start();
+        std::size_t timers = 0;
+        for (std::size_t i = 0; i < snapshot_repetitions; ++i)
+            timers += sw::timer_registry::instance().snapshot().timers.size();
+        merge.stop();
+        release = true;
+        for (std::thread& t : threads)
+            t.join();
+
+        // each iteration records two nested timers
+        const double timers_per_second = static_cast<double>(thread_count * iterations * 2) / run.elapsed().count();
+        std::cout << thread_count << ", " << timers_per_second / 1.0e6 << ", " << merge.elapsed().count() / snapshot_repetitions << (timers == 0 ? " (no timers)" : "") << "\n";
+    }
+    sw::timer_registry::instance().snapshot().print(std::cout);
+    return 0;
+}
@@ -0,0 +1,66 @@
+// Example for sw::bench::scaling_study: strong scaling of a compute bound and a memory bound kernel, and weak
+// scaling of the compute bound kernel.
+// Usage: scaling_example [table|csv|json] [--pin]
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <stopwatch/bench.hpp>
+#include <stopwatch/scaling.hpp>
+
+namespace
+{
+    constexpr std::size_t compute_items = 1 << 24;
+
+    double compute(std::size_t first, std::size_t last)
+    {
+        double sum = 0.0;
+        for (std::size_t i = first; i < last; ++i)
+            sum += std::sqrt(static_cast<double>(i));
+        return sum;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const std::string_view format = argc > 1 ? argv[1] : "table";
+    sw::bench::scaling_config config;
+    config.pin_threads = argc > 2 && std::strcmp(argv[2], "--pin") == 0;
+    config.repetitions = 3;
+    if (std::thread::hardware_concurrency() < 4)
+        config.thread_counts = {1, 2, 4};  // oversubscribed on small machines, to show the loss of efficiency
+
+    sw::bench::scaling_study study(config);
+    study.run("compute", [](std::size_t index, std::size_t count)
+    {
+        const std::size_t chunk = compute_items / count;
+        sw::bench::do_not_optimize(compute(index * chunk, index + 1 == count ? compute_items : (index + 1) * chunk));
+    });
+
+    std::vector<std::uint64_t> data(std::size_t{1} << 25, 1);
+    study.run("memory", [&](std::size_t index, std::size_t count)
+    {
+        const std::size_t chunk = data.size() / count;
+        std::uint64_t sum = 0;
+        for (std::size_t i = index * chunk; i < (index + 1) * chunk; ++i)
+            sum += data[i];
+        sw::bench::do_not_optimize(sum);
+    });
+
+    study.config().mode = sw::bench::scaling_mode::weak;
+    study.run("compute weak", [](std::size_t, std::size_t)
+    {
+        sw::bench::do_not_optimize(compute(0, compute_items / 4));
+    });
+
+    if (format == "csv")
+        study.write_csv(std::cout);
+    else if (format == "json")
+        study.write_json(std::cout);
+    else
+        study.report(std::cout);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Measures the cost of constructing, starting, stopping and destroying a stopwatch, compared
+// against a stopwatch with the previous layout that carried a std::stringstream per instance.
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stopwatch/bench.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+namespace
+{
+    // previous basic_stopwatch layout: every instance sets up a stream it rarely uses
+    struct legacy_stopwatch
+    {
+        using clock_t = std::chrono::high_resolution_clock;
+
+        explicit legacy_stopwatch(std::string_view name = {}) : m_sstrm(), m_name(name), m_t0(), m_elapsed(clock_t::duration::zero()) {}
+        void start() { m_elapsed = clock_t::duration::zero(); m_t0 = clock_t::now(); }
+        void stop() { const clock_t::time_point t1 = clock_t::now(); m_elapsed += t1 - m_t0; m_t0 = t1; }
+        clock_t::duration elapsed_clock() const { return m_elapsed; }
+        std::string elapsed_str() const
+        {
+            m_sstrm.str({});
+            m_sstrm << m_name << sw::as<sw::nanoseconds_d>(m_elapsed).count() << " " << sw::time_unit_postfix<sw::nanoseconds_d>::str();
+            return m_sstrm.str();
+        }
+
+        mutable std::stringstream m_sstrm;
+        std::string_view m_name;
+        clock_t::time_point m_t0;
+        clock_t::duration m_elapsed;
+    };
+
+    constexpr std::size_t iterations = 1000000;
+
+    template <typename stopwatch_type>
+    double lifecycle_ns()
+    {
+        std::int64_t sink = 0;
+        sw::hres_stopwatch_ns outer;
+        outer.start();
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            stopwatch_type s("section");
+            s.start();
+            s.stop();
+            sink += s.elapsed_clock().count();
+        }
+        outer.stop();
+        sw::bench::do_not_optimize(sink);
+        return outer.elapsed().count() / iterations;
+    }
+
+    template <typename stopwatch_type>
+    double format_ns()
+    {
+        std::size_t sink = 0;
+        stopwatch_type s("section ");
+        s.start();
+        s.stop();
+        sw::hres_stopwatch_ns outer;
+        outer.start();
+        for (std::size_t i = 0; i < iterations; ++i)
+            sink += s.elapsed_str().size();
+        outer.stop();
+        sw::bench::do_not_optimize(sink);
+        return outer.elapsed().count() / iterations;
+    }
+}
+
+int main()
+{
+    std::cout << "sizeof(legacy_stopwatch):    " << sizeof(legacy_stopwatch) << " bytes\n";
+    std::cout << "sizeof(hres_stopwatch_ns):   " << sizeof(sw::hres_stopwatch_ns) << " bytes\n";
+    std::cout << "construct/start/stop/destroy legacy:       " << lifecycle_ns<legacy_stopwatch>() << " ns\n";
+    std::cout << "construct/start/stop/destroy stopwatch:    " << lifecycle_ns<sw::hres_stopwatch_ns>() << " ns\n";
+    std::cout << "elapsed_str legacy:                        " << format_ns<legacy_stopwatch>() << " ns\n";
+    std::cout << "elapsed_str stopwatch:                     " << format_ns<sw::hres_stopwatch_ns>() << " ns\n";
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Times a coroutine that hops to other threads at every co_await with a task stopwatch, so that the time spent
+// waiting is reported as suspended instead of active time, and a callback chain that pauses the stopwatch by hand.
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stopwatch/task_stopwatch_coro.hpp>
+
+namespace
+{
+    // eagerly started fire and forget coroutine timed through the promise mixin; the scoped stopwatch reports when the
+    // frame is destroyed
+    struct task
+    {
+        struct promise_type : sw::timed_promise<sw::steady_scoped_task_stopwatch_ms, false>
+        {
+            promise_type() : timed_promise("coroutine: ") {}
+            task get_return_object() { return task{}; }
+            std::suspend_never final_suspend() noexcept
+            {
+                stop_timing();
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    // resumes the awaiting coroutine on a new thread after a delay, like an i/o completion would
+    class io_pool
+    {
+    public:
+        struct delay
+        {
+            io_pool& pool;
+            std::chrono::milliseconds duration;
+
+            bool await_ready() const noexcept { return false; }
+            void await_suspend(std::coroutine_handle<> h) { pool.post(h, duration); }
+            void await_resume() const noexcept {}
+        };
+
+        delay after(std::chrono::milliseconds duration) { return delay{*this, duration}; }
+
+        void post(std::coroutine_handle<> h, std::chrono::milliseconds duration)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_threads.emplace_back([h, duration]()
+            {
+                std::this_thread::sleep_for(duration);
+                h.resume();
+            });
+        }
+
+        void join()
+        {
+            for (;;)
+            {
+                std::vector<std::thread> threads;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    threads.swap(m_threads);
+                }
+                if (threads.empty())
+                    return;
+                for (std::thread& t : threads)
+                    t.join();
+            }
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::vector<std::thread> m_threads;
+    };
+
+    void spin(std::chrono::milliseconds duration)
+    {
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < end)
+            ;
+    }
+
+    // 3 x 10 ms of work, 3 waits of 20 ms each on other threads
+    task request(io_pool& pool)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            spin(std::chrono::milliseconds(10));
+            co_await pool.after(std::chrono::milliseconds(20));
+        }
+    }
+}
+
+int main()
+{
+    io_pool pool;
+    request(pool);
+    pool.join();
+
+    // without coroutines: suspend before handing the task over, resume in the continuation
+    sw::steady_task_stopwatch_ms s("callback chain: ");
+    s.start();
+    spin(std::chrono::milliseconds(10));
+    s.suspend();
+    std::thread continuation([&s]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        s.resume();
+        spin(std::chrono::milliseconds(10));
+        s.stop();
+    });
+    continuation.join();
+    s.report_elapsed();
+    return 0;
+}
@@ -0,0 +1,254 @@
+#ifndef _STOPWATCH_ANY_CLOCK_HPP_
+#define _STOPWATCH_ANY_CLOCK_HPP_
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <stopwatch/calibration.hpp>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+// resolution in nanoseconds the automatically selected clock of sw::any_clock must provide
+#if !defined(STOPWATCH_ANY_CLOCK_RESOLUTION_NS)
+	#define STOPWATCH_ANY_CLOCK_RESOLUTION_NS 1000
+#endif
+
+namespace sw
+{
+	// clocks sw::any_clock can dispatch to
+	enum class clock_kind
+	{
+		steady = 0,
+		monotonic_coarse = 1,
+		monotonic_raw = 2,
+		boottime = 3,
+		tsc = 4
+	};
+
+	// a clock sw::any_clock can select
+	struct clock_candidate
+	{
+		clock_kind kind;
+		std::string_view name;
+		bool available;							// false if the clock falls back to another one on this system
+		std::int64_t (*now)() noexcept;			// nanoseconds since the epoch of the clock
+		const clock_calibration& (*calibration)();
+	};
+
+	/*
+		Steady clock whose now() dispatches at runtime through a function pointer to one of the clocks in clock_kind.
+		It dispatches to steady_clock unless select() or select_cheapest() chose another clock before the first call
+		to now(). The first call fixes the clock for the rest of the program, later selections fail, so all time
+		points share one epoch. now() never calibrates; call select_cheapest() at startup to pay for that up front.
+	*/
+	struct any_clock
+	{
+		using rep = std::int64_t;
+		using period = std::nano;
+		using duration = std::chrono::duration<rep, period>;
+		using time_point = std::chrono::time_point<any_clock>;
+
+		static constexpr bool is_steady = true;
+
+		static time_point now() noexcept
+		{
+			return time_point{duration{current().load(std::memory_order_relaxed)()}};
+		}
+
+		/**
+			* @brief Makes now() dispatch to the given clock. Only possible before the first call to now().
+			* @param k	Clock to use.
+			* @return	False if the clock is not available on this system or now() was called already, the
+			*			selection is unchanged then.
+		*/
+		static bool select(clock_kind k) noexcept;
+
+		/**
+			* @brief Calibrates the available clocks (if not done before) and returns the one with the lowest overhead
+			*		 whose resolution is at least the required one, steady_clock if none qualifies. Selects nothing.
+			* @param required_resolution	Largest acceptable resolution, e.g. milliseconds(10) admits coarse clocks.
+		*/
+		template <typename duration_t = nanoseconds_d>
+		static clock_kind cheapest(const duration_t& required_resolution = duration_t{nanoseconds_d{STOPWATCH_ANY_CLOCK_RESOLUTION_NS}});
+
+		/**
+			* @brief Selects the cheapest() clock with the required resolution, unless now() was called already.
+			* @param required_resolution	Largest acceptable resolution, e.g. milliseconds(10) admits coarse clocks.
+			* @return						The clock now() dispatches to.
+		*/
+		template <typename duration_t = nanoseconds_d>
+		static clock_kind select_cheapest(const duration_t& required_resolution = duration_t{nanoseconds_d{STOPWATCH_ANY_CLOCK_RESOLUTION_NS}});
+
+		/**
+			* @brief Returns the clock now() dispatches to, or will dispatch to if it was not called yet.
+		*/
+		static clock_kind selected() noexcept;
+
+		/**
+			* @brief Returns all clocks any_clock can dispatch to, in the order of clock_kind.
+		*/
+		static const std::array<clock_candidate, 5>& candidates() noexcept;
+
+		/**
+			* @brief Prints the calibration of every available clock and marks the selected one with '*'.
+		*/
+		template <typename ostrm>
+		static void report(ostrm& s);
+
+	private:
+		using now_fn = std::int64_t (*)() noexcept;
+
+		template <typename clock_type>
+		static std::int64_t now_ns() noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now().time_since_epoch()).count();
+		}
+
+		template <typename clock_type>
+		static const clock_calibration& calibration_of()
+		{
+			return clock_calibration_of<clock_type>();
+		}
+
+		// until the first call to now(), current() holds the first_now of the selected clock, which swaps itself
+		// for the plain reading and thereby fixes the selection
+		template <typename clock_type>
+		static std::int64_t first_now() noexcept
+		{
+			now_fn expected = &first_now<clock_type>;
+			current().compare_exchange_strong(expected, &now_ns<clock_type>, std::memory_order_relaxed);
+			return now_ns<clock_type>();
+		}
+
+		static now_fn first_now_of(clock_kind k) noexcept;
+		static bool is_first_now(now_fn f) noexcept;
+
+		static std::atomic<now_fn>& current() noexcept
+		{
+			static std::atomic<now_fn> f{&first_now<std::chrono::steady_clock>};
+			return f;
+		}
+	};
+
+	using any_stopwatch_ms = basic_stopwatch<any_clock, sw::milliseconds_d, false, false>;
+	using any_stopwatch_us = basic_stopwatch<any_clock, sw::microseconds_d, false, false>;
+	using any_stopwatch_ns = basic_stopwatch<any_clock, sw::nanoseconds_d, false, false>;
+	using any_auto_stopwatch_ms = basic_stopwatch<any_clock, sw::milliseconds_d, true, false>;
+	using any_auto_stopwatch_us = basic_stopwatch<any_clock, sw::microseconds_d, true, false>;
+	using any_auto_stopwatch_ns = basic_stopwatch<any_clock, sw::nanoseconds_d, true, false>;
+	using any_scoped_stopwatch_ms = basic_stopwatch<any_clock, sw::milliseconds_d, true, true>;
+	using any_scoped_stopwatch_us = basic_stopwatch<any_clock, sw::microseconds_d, true, true>;
+	using any_scoped_stopwatch_ns = basic_stopwatch<any_clock, sw::nanoseconds_d, true, true>;
+}
+
+// --- implementation ---
+
+inline const std::array<sw::clock_candidate, 5>& sw::any_clock::candidates() noexcept
+{
+	static const std::array<clock_candidate, 5> c{{
+		{clock_kind::steady, "steady_clock", true, &now_ns<std::chrono::steady_clock>, &calibration_of<std::chrono::steady_clock>},
+		{clock_kind::monotonic_coarse, "monotonic_coarse_clock", STOPWATCH_HAS_MONOTONIC_COARSE_CLOCK != 0, &now_ns<monotonic_coarse_clock>, &calibration_of<monotonic_coarse_clock>},
+		{clock_kind::monotonic_raw, "monotonic_raw_clock", STOPWATCH_HAS_MONOTONIC_RAW_CLOCK != 0, &now_ns<monotonic_raw_clock>, &calibration_of<monotonic_raw_clock>},
+		{clock_kind::boottime, "boottime_clock", STOPWATCH_HAS_BOOTTIME_CLOCK != 0, &now_ns<boottime_clock>, &calibration_of<boottime_clock>},
+		{clock_kind::tsc, "tsc_clock", tsc_clock::calibrate(), &now_ns<tsc_clock>, &calibration_of<tsc_clock>}
+	}};
+	return c;
+}
+
+inline bool sw::any_clock::select(clock_kind k) noexcept
+{
+	if (!candidates()[static_cast<std::size_t>(k)].available)
+		return false;
+	now_fn f = current().load(std::memory_order_relaxed);
+	do
+	{
+		if (!is_first_now(f))
+			return false;
+	} while (!current().compare_exchange_weak(f, first_now_of(k), std::memory_order_relaxed));
+	return true;
+}
+
+template <typename duration_t>
+inline sw::clock_kind sw::any_clock::cheapest(const duration_t& required_resolution)
+{
+	const nanoseconds_d required = as<nanoseconds_d>(required_resolution);
+	const clock_candidate* best = &candidates()[static_cast<std::size_t>(clock_kind::steady)];
+	nanoseconds_d best_overhead = nanoseconds_d::max();
+	for (const clock_candidate& c : candidates())
+	{
+		if (!c.available)
+			continue;
+		const clock_calibration& cal = c.calibration();
+		if (cal.resolution > required || cal.overhead >= best_overhead)
+			continue;
+		best = &c;
+		best_overhead = cal.overhead;
+	}
+	return best->kind;
+}
+
+template <typename duration_t>
+inline sw::clock_kind sw::any_clock::select_cheapest(const duration_t& required_resolution)
+{
+	// calibrating takes a few ms per clock, skip it once the selection is fixed
+	if (!is_first_now(current().load(std::memory_order_relaxed)))
+		return selected();
+	select(cheapest(required_resolution));
+	return selected();
+}
+
+inline sw::clock_kind sw::any_clock::selected() noexcept
+{
+	const now_fn f = current().load(std::memory_order_relaxed);
+	for (const clock_candidate& c : candidates())
+	{
+		if (c.now == f || first_now_of(c.kind) == f)
+			return c.kind;
+	}
+	return clock_kind::steady;
+}
+
+inline sw::any_clock::now_fn sw::any_clock::first_now_of(clock_kind k) noexcept
+{
+	switch (k)
+	{
+	case clock_kind::monotonic_coarse: return &first_now<monotonic_coarse_clock>;
+	case clock_kind::monotonic_raw: return &first_now<monotonic_raw_clock>;
+	case clock_kind::boottime: return &first_now<boottime_clock>;
+	case clock_kind::tsc: return &first_now<tsc_clock>;
+	default: return &first_now<std::chrono::steady_clock>;
+	}
+}
+
+inline bool sw::any_clock::is_first_now(now_fn f) noexcept
+{
+	for (const clock_candidate& c : candidates())
+	{
+		if (first_now_of(c.kind) == f)
+			return true;
+	}
+	return false;
+}
+
+template <typename ostrm>
+inline void sw::any_clock::report(ostrm& s)
+{
+	const clock_kind k = selected();
+	for (const clock_candidate& c : candidates())
+	{
+		if (!c.available)
+		{
+			s << "  " << c.name << ": not available" << std::endl;
+			continue;
+		}
+		const std::string name = std::string(c.kind == k ? "* " : "  ").append(c.name).append(": ");
+		c.calibration().report(s, name);
+	}
+}
+
+#endif
@@ -0,0 +1,312 @@
+#ifndef _STOPWATCH_BENCH_HPP_
+#define _STOPWATCH_BENCH_HPP_
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stopwatch/common.hpp>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace sw
+{
+	namespace bench
+	{
+		namespace detail
+		{
+			inline const volatile void* volatile escape_sink = nullptr;
+		}
+
+		/**
+			* @brief Makes the compiler assume that value is read, so that its computation is not optimized away.
+		*/
+		template <typename value_type>
+		inline void do_not_optimize(const value_type& value)
+		{
+#if defined(__GNUC__)
+			asm volatile("" : : "r,m"(value) : "memory");
+#else
+			detail::escape_sink = &value;
+	#if defined(_MSC_VER)
+			_ReadWriteBarrier();
+	#endif
+#endif
+		}
+
+		/**
+			* @brief Makes the compiler assume that all memory is read and written, forcing pending stores.
+		*/
+		inline void clobber_memory()
+		{
+#if defined(__GNUC__)
+			asm volatile("" : : : "memory");
+#elif defined(_MSC_VER)
+			_ReadWriteBarrier();
+#endif
+		}
+
+		// benchmark settings
+		struct config
+		{
+			std::chrono::nanoseconds warmup_time = std::chrono::milliseconds(100);	// run before sampling, also used to estimate the iteration count
+			std::chrono::nanoseconds sample_time = std::chrono::milliseconds(10);	// target run time of one sample
+			std::size_t samples = 30;												// number of samples
+			std::size_t max_iterations = 1000000000;								// upper bound of iterations per sample
+			double outlier_threshold = 3.0;											// samples further than this many (scaled) MADs from the median are rejected
+		};
+
+		// per iteration timings of one benchmark
+		struct result
+		{
+			std::string name;
+			bool has_param = false;
+			std::int64_t param = 0;
+			std::size_t iterations = 0;	// iterations per sample
+			std::size_t samples = 0;	// samples kept after outlier rejection
+			std::size_t outliers = 0;	// rejected samples
+			nanoseconds_d median{0.0};
+			nanoseconds_d mad{0.0};		// median absolute deviation from the median
+			nanoseconds_d min{0.0};
+			nanoseconds_d mean{0.0};
+		};
+
+		/*
+			Micro benchmark runner. Every benchmark is warmed up, then the number of
+			iterations per sample is chosen such that one sample takes about config::sample_time. Per iteration
+			times of all samples are reduced to median, MAD, min and mean after rejecting outliers. Samples are timed
+			with steady_clock directly rather than a basic_stopwatch, so benchmarks keep working in translation units
+			built with STOPWATCH_DISABLE.
+		*/
+		class runner
+		{
+		public:
+			explicit runner(const config& c = config{}) : m_config(c), m_results() {}
+			/**
+				* @brief Benchmarks a callable.
+				* @param name	Benchmark name.
+				* @param f		Callable invoked once per iteration without arguments.
+				* @return		Result of the benchmark, also stored in results().
+			*/
+			template <typename fn>
+			const result& run(std::string_view name, fn&& f);
+			/**
+				* @brief Benchmarks a callable for each of a set of parameters, e.g. input sizes.
+				* @param name	Benchmark name.
+				* @param params	Parameters.
+				* @param f		Callable invoked once per iteration with the parameter.
+			*/
+			template <typename fn>
+			void run(std::string_view name, const std::vector<std::int64_t>& params, fn&& f);
+			/// Returns the results of all benchmarks run so far.
+			const std::vector<result>& results() const noexcept { return m_results; }
+			/**
+				* @brief Prints a human readable table of all results.
+			*/
+			template <typename ostrm>
+			void report(ostrm& s) const;
+			/**
+				* @brief Writes all results as csv with a header line. Times are in nanoseconds per iteration.
+			*/
+			template <typename ostrm>
+			void write_csv(ostrm& s) const;
+			/**
+				* @brief Writes all results as a json object with a "benchmarks" array. Times are in nanoseconds per iteration.
+			*/
+			template <typename ostrm>
+			void write_json(ostrm& s) const;
+
+		private:
+			template <typename fn>
+			result measure(fn& f) const;
+			template <typename fn>
+			static nanoseconds_d time_iterations(fn& f, std::size_t iterations);
+
+			config m_config;
+			std::vector<result> m_results;
+		};
+	}
+}
+
+// --- implementation ---
+
+template <typename fn>
+inline const sw::bench::result& sw::bench::runner::run(std::string_view name, fn&& f)
+{
+	result r = measure(f);
+	r.name.assign(name);
+	m_results.push_back(std::move(r));
+	return m_results.back();
+}
+
+template <typename fn>
+inline void sw::bench::runner::run(std::string_view name, const std::vector<std::int64_t>& params, fn&& f)
+{
+	for (const std::int64_t param : params)
+	{
+		auto bound = [&f, param]() { f(param); };
+		result r = measure(bound);
+		r.name.assign(name);
+		r.has_param = true;
+		r.param = param;
+		m_results.push_back(std::move(r));
+	}
+}
+
+template <typename ostrm>
+inline void sw::bench::runner::report(ostrm& s) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const nanoseconds_d& d)
+	{
+		const char* const end = sw::format_duration(buffer, d);
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	for (const result& r : m_results)
+	{
+		s << r.name;
+		if (r.has_param)
+			s << '/' << r.param;
+		field(": median ", r.median);
+		field(", mad ", r.mad);
+		field(", min ", r.min);
+		field(", mean ", r.mean);
+		s << ", iterations " << r.iterations << ", samples " << r.samples << ", outliers " << r.outliers << '\n';
+	}
+	s.flush();
+}
+
+template <typename ostrm>
+inline void sw::bench::runner::write_csv(ostrm& s) const
+{
+	s << "name,param,iterations,samples,outliers,median_ns,mad_ns,min_ns,mean_ns\n";
+	for (const result& r : m_results)
+	{
+		// quote names, doubling embedded quotes
+		s << '"';
+		for (const char c : r.name)
+			s << (c == '"' ? "\"\"" : std::string_view(&c, 1));
+		s << "\",";
+		if (r.has_param)
+			s << r.param;
+		s << ',' << r.iterations << ',' << r.samples << ',' << r.outliers << ','
+		  << r.median.count() << ',' << r.mad.count() << ',' << r.min.count() << ',' << r.mean.count() << '\n';
+	}
+	s.flush();
+}
+
+template <typename ostrm>
+inline void sw::bench::runner::write_json(ostrm& s) const
+{
+	std::string out = "{\"benchmarks\":[";
+	char buffer[sw::max_duration_str_length];
+	const auto number = [&](const char* key, double value)
+	{
+		out += key;
+		out.append(buffer, sw::format_count(buffer, value));
+	};
+	for (std::size_t i = 0; i < m_results.size(); ++i)
+	{
+		const result& r = m_results[i];
+		out += i == 0 ? "\n{\"name\":" : ",\n{\"name\":";
+		sw::detail::append_json_string(out, r.name);
+		if (r.has_param)
+			out += ",\"param\":" + std::to_string(r.param);
+		out += ",\"iterations\":" + std::to_string(r.iterations);
+		out += ",\"samples\":" + std::to_string(r.samples);
+		out += ",\"outliers\":" + std::to_string(r.outliers);
+		number(",\"median_ns\":", r.median.count());
+		number(",\"mad_ns\":", r.mad.count());
+		number(",\"min_ns\":", r.min.count());
+		number(",\"mean_ns\":", r.mean.count());
+		out += '}';
+	}
+	out += "\n]}\n";
+	s << out;
+	s.flush();
+}
+
+template <typename fn>
+inline sw::bench::result sw::bench::runner::measure(fn& f) const
+{
+	// warm up with doubling iteration counts, which also tells the cost of one iteration
+	std::size_t iterations = 1;
+	nanoseconds_d warmup_elapsed{0.0};
+	nanoseconds_d last{0.0};
+	while (warmup_elapsed < m_config.warmup_time || last < as<nanoseconds_d>(m_config.sample_time) / 10.0)
+	{
+		last = time_iterations(f, iterations);
+		warmup_elapsed += last;
+		if (iterations >= m_config.max_iterations)
+			break;
+		if (last < as<nanoseconds_d>(m_config.sample_time) / 10.0)
+			iterations = std::min(iterations * 2, m_config.max_iterations);
+		else if (warmup_elapsed >= m_config.warmup_time)
+			break;
+	}
+	const double per_iteration = std::max(last.count() / static_cast<double>(iterations), 1e-3);
+	iterations = static_cast<std::size_t>(std::clamp(as<nanoseconds_d>(m_config.sample_time).count() / per_iteration, 1.0, static_cast<double>(m_config.max_iterations)));
+
+	std::vector<double> times(std::max<std::size_t>(m_config.samples, 1));
+	for (double& t : times)
+		t = time_iterations(f, iterations).count() / static_cast<double>(iterations);
+
+	const auto median_of = [](std::vector<double> v)
+	{
+		const std::size_t mid = v.size() / 2;
+		std::nth_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(mid), v.end());
+		if (v.size() % 2 == 1)
+			return v[mid];
+		return 0.5 * (v[mid] + *std::max_element(v.begin(), v.begin() + static_cast<std::ptrdiff_t>(mid)));
+	};
+	const auto mad_of = [&median_of](const std::vector<double>& v, double median)
+	{
+		std::vector<double> deviations(v.size());
+		std::transform(v.begin(), v.end(), deviations.begin(), [median](double x) { return std::abs(x - median); });
+		return median_of(std::move(deviations));
+	};
+
+	// reject samples more than outlier_threshold scaled MADs (1.4826 * MAD estimates the standard deviation) away
+	const double median = median_of(times);
+	const double mad = mad_of(times, median);
+	std::vector<double> kept;
+	kept.reserve(times.size());
+	for (const double t : times)
+	{
+		if (mad <= 0.0 || std::abs(t - median) <= m_config.outlier_threshold * 1.4826 * mad)
+			kept.push_back(t);
+	}
+
+	result r;
+	r.iterations = iterations;
+	r.samples = kept.size();
+	r.outliers = times.size() - kept.size();
+	const double kept_median = median_of(kept);
+	r.median = nanoseconds_d{kept_median};
+	r.mad = nanoseconds_d{mad_of(kept, kept_median)};
+	r.min = nanoseconds_d{*std::min_element(kept.begin(), kept.end())};
+	double sum = 0.0;
+	for (const double t : kept)
+		sum += t;
+	r.mean = nanoseconds_d{sum / static_cast<double>(kept.size())};
+	return r;
+}
+
+template <typename fn>
+inline sw::nanoseconds_d sw::bench::runner::time_iterations(fn& f, std::size_t iterations)
+{
+	const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < iterations; ++i)
+	{
+		f();
+		clobber_memory();
+	}
+	return as<nanoseconds_d>(std::chrono::steady_clock::now() - t0);
+}
+
+#endif
@@ -0,0 +1,496 @@
+#ifndef _STOPWATCH_BUDGET_STOPWATCH_HPP_
+#define _STOPWATCH_BUDGET_STOPWATCH_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/sink.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+// number of overruns buffered for the callback thread, rounded up to a power of two
+#if !defined(STOPWATCH_BUDGET_OVERRUN_QUEUE_CAPACITY)
+	#define STOPWATCH_BUDGET_OVERRUN_QUEUE_CAPACITY 1024
+#endif
+
+namespace sw
+{
+	// values of a budget_stats aggregate at one point in time
+	struct budget_summary
+	{
+		std::uint64_t checks = 0;			// intervals checked against their budget
+		std::uint64_t overruns = 0;			// intervals that exceeded their budget
+		nanoseconds_d total_overrun{0.0};	// sum of the time by which the budgets were exceeded
+		nanoseconds_d max_overrun{0.0};		// largest single overrun
+
+		double overrun_ratio() const noexcept { return checks != 0 ? static_cast<double>(overruns) / static_cast<double>(checks) : 0.0; }
+		nanoseconds_d mean_overrun() const noexcept { return overruns != 0 ? total_overrun / static_cast<double>(overruns) : nanoseconds_d{0.0}; }
+		/**
+			* @brief Prints checks, overruns and the mean and max overrun on a single line.
+			* @param s		Output stream.
+			* @param name	Name printed in front of the values.
+		*/
+		template <typename ostrm>
+		void report(ostrm& s, std::string_view name = {}) const;
+	};
+
+	// Compact aggregate of budget checks: four counters on their own cache line, updated with relaxed atomics,
+	// so that budget stopwatches on any thread may share one instance per stage.
+	class budget_stats
+	{
+	public:
+		budget_stats() noexcept : m_checks(0), m_overruns(0), m_total_overrun_ns(0), m_max_overrun_ns(0) {}
+		budget_stats(const budget_stats&) = delete;
+		budget_stats& operator=(const budget_stats&) = delete;
+
+		/**
+			* @brief Records one check.
+			* @param overrun	Time by which the budget was exceeded, zero or negative if it was met.
+		*/
+		void record(std::chrono::nanoseconds overrun) noexcept;
+		/**
+			* @brief Returns the current values. Counters are read one by one, so concurrent records may be partially included.
+		*/
+		budget_summary snapshot() const noexcept;
+		/**
+			* @brief Clears all counters.
+		*/
+		void reset() noexcept;
+
+	private:
+		alignas(64) std::atomic<std::uint64_t> m_checks;
+		std::atomic<std::uint64_t> m_overruns;
+		std::atomic<std::uint64_t> m_total_overrun_ns;
+		std::atomic<std::uint64_t> m_max_overrun_ns;
+	};
+
+	// an exceeded budget as passed to an overrun callback
+	struct budget_overrun
+	{
+		static constexpr std::size_t max_name_length = report_record::max_name_length;
+
+		char name_data[max_name_length + 1];	// truncated copy of the stopwatch name, so that it may dangle afterwards
+		std::uint8_t name_length;
+		nanoseconds_d budget;
+		nanoseconds_d elapsed;
+		void* context;							// user pointer given to the stopwatch
+
+		std::string_view name() const noexcept { return std::string_view(name_data, name_length); }
+		nanoseconds_d overrun() const noexcept { return elapsed - budget; }
+	};
+
+	// called on the overrun dispatcher thread, never on the thread whose budget was exceeded
+	using budget_overrun_callback = void (*)(const budget_overrun&);
+
+	/*
+		Background thread invoking overrun callbacks. Stopwatches push overruns into a bounded lock-free queue and
+		return immediately; the thread, started on the first overrun with a callback and woken whenever overruns
+		arrive while it sleeps, calls the callbacks in submission order. Overruns that do not fit into the queue are
+		counted as lost. At exit the thread is stopped and the remaining callbacks are invoked; later overruns call
+		back synchronously.
+	*/
+	class budget_overrun_dispatcher
+	{
+	public:
+		/**
+			* @brief Returns the process wide dispatcher. The background thread starts with the first submitted overrun.
+		*/
+		static budget_overrun_dispatcher& instance();
+		/**
+			* @brief Queues a callback invocation. Never blocks.
+			* @param callback	Callback to invoke.
+			* @param overrun	Argument of the callback.
+		*/
+		void submit(budget_overrun_callback callback, const budget_overrun& overrun) noexcept;
+		/**
+			* @brief Invokes all callbacks queued so far on the calling thread.
+		*/
+		void flush();
+		/**
+			* @brief Returns the number of callback invocations dropped because the queue was full.
+		*/
+		std::uint64_t lost() const noexcept { return m_lost.load(std::memory_order_relaxed); }
+
+	private:
+		struct entry
+		{
+			budget_overrun_callback callback;
+			budget_overrun overrun;
+		};
+
+		budget_overrun_dispatcher();
+		// drain function of the worker thread
+		static std::size_t dispatch(void* dispatcher);
+		// invokes queued callbacks, the dispatch mutex must be held
+		std::size_t drain() noexcept;
+		void shutdown();
+
+		detail::bounded_queue<entry> m_queue;
+		std::atomic<std::uint64_t> m_lost;
+		std::atomic<bool> m_shut_down;
+		std::mutex m_dispatch_mutex;
+		detail::wakeup_worker m_worker;
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		/*
+			Stopwatch with a time budget. remaining() tells how much of the budget is left, also while the stopwatch runs.
+			check() stops the stopwatch and compares the elapsed time with the budget: the result goes into an optional
+			budget_stats aggregate, and an overrun queues the optional callback on the budget_overrun_dispatcher instead
+			of reporting synchronously. If check_at_destruction is true, the destructor checks unless check() was called.
+		*/
+		template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+		class basic_budget_stopwatch : public basic_stopwatch<clock_type, report_duration, auto_start_on_construction, false>
+		{
+		public:
+			using base_t = basic_stopwatch<clock_type, report_duration, auto_start_on_construction, false>;
+			using typename base_t::clock_t;
+			using typename base_t::clock_duration_t;
+			using typename base_t::clock_time_point_t;
+			using typename base_t::report_duration_t;
+
+			/**
+				* @brief Creates a new basic_budget_stopwatch.
+				* @param budget		Time budget of the measured section.
+				* @param name		Name of the stopwatch, copied into overrun callbacks.
+				* @param stats		Aggregate receiving the result of every check, may be null.
+				* @param callback	Invoked off the calling thread for every overrun, may be null.
+				* @param context	User pointer passed on to the callback.
+			*/
+			template <typename budget_duration>
+			explicit basic_budget_stopwatch(const budget_duration& budget, std::string_view name = {}, budget_stats* stats = nullptr,
+											budget_overrun_callback callback = nullptr, void* context = nullptr);
+			basic_budget_stopwatch(const basic_budget_stopwatch&) = default;
+			/// Destructor. Checks the budget if check_at_destruction is true and check() was not called since the last start.
+			~basic_budget_stopwatch();
+			/**
+				* @brief Resets the elapsed time and starts the stopwatch, allowing another check.
+				* @return Time point of stopwatch start.
+			*/
+			clock_time_point_t start();
+			/**
+				* @brief Resumes the stopwatch without resetting the elapsed time.
+				* @return Time point of stopwatch resume.
+			*/
+			clock_time_point_t resume();
+			/**
+				* @brief Stops the stopwatch without checking the budget.
+				* @return Time point of stopwatch stop.
+			*/
+			clock_time_point_t stop();
+			/**
+				* @brief Stops the stopwatch and checks the elapsed time against the budget.
+				* @return True if the budget was met.
+			*/
+			bool check();
+			/**
+				* @brief Returns the budget.
+			*/
+			report_duration_t budget() const { return as<report_duration_t>(m_budget); }
+			/**
+				* @brief Returns the budget left, including the time since the last start or resume if the stopwatch runs.
+				*		 Negative once the budget is exceeded.
+			*/
+			report_duration_t remaining() const { return as<report_duration_t>(remaining_clock()); }
+			/**
+				* @brief Returns the budget left in clock duration, see remaining().
+			*/
+			clock_duration_t remaining_clock() const;
+			/**
+				* @brief Returns true if the budget is exceeded, including the time since the last start or resume if the stopwatch runs.
+			*/
+			bool exceeded() const { return remaining_clock() < clock_duration_t::zero(); }
+
+		private:
+			clock_duration_t m_budget;
+			budget_stats* m_stats;
+			budget_overrun_callback m_callback;
+			void* m_context;
+			bool m_running;
+			bool m_checked;
+		};
+	}
+
+	using hres_budget_stopwatch_ms 			= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, false, false>;
+	using hres_budget_stopwatch_us 			= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, false, false>;
+	using hres_budget_stopwatch_ns 			= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, false, false>;
+	using hres_auto_budget_stopwatch_ms 	= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, true, false>;
+	using hres_auto_budget_stopwatch_us 	= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, true, false>;
+	using hres_auto_budget_stopwatch_ns 	= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, true, false>;
+	using hres_scoped_budget_stopwatch_ms 	= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, true, true>;
+	using hres_scoped_budget_stopwatch_us 	= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, true, true>;
+	using hres_scoped_budget_stopwatch_ns 	= basic_budget_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, true, true>;
+
+	using sys_budget_stopwatch_ms 			= basic_budget_stopwatch<std::chrono::system_clock, sw::milliseconds_d, false, false>;
+	using sys_budget_stopwatch_us 			= basic_budget_stopwatch<std::chrono::system_clock, sw::microseconds_d, false, false>;
+	using sys_budget_stopwatch_ns 			= basic_budget_stopwatch<std::chrono::system_clock, sw::nanoseconds_d, false, false>;
+	using sys_auto_budget_stopwatch_ms 		= basic_budget_stopwatch<std::chrono::system_clock, sw::milliseconds_d, true, false>;
+	using sys_auto_budget_stopwatch_us 		= basic_budget_stopwatch<std::chrono::system_clock, sw::microseconds_d, true, false>;
+	using sys_auto_budget_stopwatch_ns 		= basic_budget_stopwatch<std::chrono::system_clock, sw::nanoseconds_d, true, false>;
+	using sys_scoped_budget_stopwatch_ms 	= basic_budget_stopwatch<std::chrono::system_clock, sw::milliseconds_d, true, true>;
+	using sys_scoped_budget_stopwatch_us 	= basic_budget_stopwatch<std::chrono::system_clock, sw::microseconds_d, true, true>;
+	using sys_scoped_budget_stopwatch_ns 	= basic_budget_stopwatch<std::chrono::system_clock, sw::nanoseconds_d, true, true>;
+
+	using cpu_budget_stopwatch_ms 			= basic_budget_stopwatch<cpu_clock, sw::milliseconds_d, false, false>;
+	using cpu_budget_stopwatch_us 			= basic_budget_stopwatch<cpu_clock, sw::microseconds_d, false, false>;
+	using cpu_budget_stopwatch_ns 			= basic_budget_stopwatch<cpu_clock, sw::nanoseconds_d, false, false>;
+	using cpu_auto_budget_stopwatch_ms 		= basic_budget_stopwatch<cpu_clock, sw::milliseconds_d, true, false>;
+	using cpu_auto_budget_stopwatch_us 		= basic_budget_stopwatch<cpu_clock, sw::microseconds_d, true, false>;
+	using cpu_auto_budget_stopwatch_ns 		= basic_budget_stopwatch<cpu_clock, sw::nanoseconds_d, true, false>;
+	using cpu_scoped_budget_stopwatch_ms 	= basic_budget_stopwatch<cpu_clock, sw::milliseconds_d, true, true>;
+	using cpu_scoped_budget_stopwatch_us 	= basic_budget_stopwatch<cpu_clock, sw::microseconds_d, true, true>;
+	using cpu_scoped_budget_stopwatch_ns 	= basic_budget_stopwatch<cpu_clock, sw::nanoseconds_d, true, true>;
+
+	using tsc_budget_stopwatch_ms 			= basic_budget_stopwatch<tsc_clock, sw::milliseconds_d, false, false>;
+	using tsc_budget_stopwatch_us 			= basic_budget_stopwatch<tsc_clock, sw::microseconds_d, false, false>;
+	using tsc_budget_stopwatch_ns 			= basic_budget_stopwatch<tsc_clock, sw::nanoseconds_d, false, false>;
+	using tsc_auto_budget_stopwatch_ms 		= basic_budget_stopwatch<tsc_clock, sw::milliseconds_d, true, false>;
+	using tsc_auto_budget_stopwatch_us 		= basic_budget_stopwatch<tsc_clock, sw::microseconds_d, true, false>;
+	using tsc_auto_budget_stopwatch_ns 		= basic_budget_stopwatch<tsc_clock, sw::nanoseconds_d, true, false>;
+	using tsc_scoped_budget_stopwatch_ms 	= basic_budget_stopwatch<tsc_clock, sw::milliseconds_d, true, true>;
+	using tsc_scoped_budget_stopwatch_us 	= basic_budget_stopwatch<tsc_clock, sw::microseconds_d, true, true>;
+	using tsc_scoped_budget_stopwatch_ns 	= basic_budget_stopwatch<tsc_clock, sw::nanoseconds_d, true, true>;
+}
+
+// --- implementation ---
+
+template <typename ostrm>
+inline void sw::budget_summary::report(ostrm& s, std::string_view name) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const nanoseconds_d& d)
+	{
+		const char* const end = sw::format_duration(buffer, d);
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	s << name << "checks " << checks << ", overruns " << overruns << " (" << overrun_ratio() * 100.0 << " %)";
+	field(", mean overrun ", mean_overrun());
+	field(", max overrun ", max_overrun);
+	s << std::endl;
+}
+
+inline void sw::budget_stats::record(std::chrono::nanoseconds overrun) noexcept
+{
+	m_checks.fetch_add(1, std::memory_order_relaxed);
+	if (overrun <= std::chrono::nanoseconds::zero())
+		return;
+	const std::uint64_t ns = static_cast<std::uint64_t>(overrun.count());
+	m_overruns.fetch_add(1, std::memory_order_relaxed);
+	m_total_overrun_ns.fetch_add(ns, std::memory_order_relaxed);
+	std::uint64_t max = m_max_overrun_ns.load(std::memory_order_relaxed);
+	while (ns > max && !m_max_overrun_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+		;
+}
+
+inline sw::budget_summary sw::budget_stats::snapshot() const noexcept
+{
+	budget_summary s;
+	s.checks = m_checks.load(std::memory_order_relaxed);
+	s.overruns = m_overruns.load(std::memory_order_relaxed);
+	s.total_overrun = nanoseconds_d{static_cast<double>(m_total_overrun_ns.load(std::memory_order_relaxed))};
+	s.max_overrun = nanoseconds_d{static_cast<double>(m_max_overrun_ns.load(std::memory_order_relaxed))};
+	return s;
+}
+
+inline void sw::budget_stats::reset() noexcept
+{
+	m_checks.store(0, std::memory_order_relaxed);
+	m_overruns.store(0, std::memory_order_relaxed);
+	m_total_overrun_ns.store(0, std::memory_order_relaxed);
+	m_max_overrun_ns.store(0, std::memory_order_relaxed);
+}
+
+inline sw::budget_overrun_dispatcher& sw::budget_overrun_dispatcher::instance()
+{
+	// never destroyed, so that budget stopwatches in static destructors can still call back
+	static budget_overrun_dispatcher* const dispatcher = []()
+	{
+		budget_overrun_dispatcher* d = new budget_overrun_dispatcher();
+		std::atexit([]() { instance().shutdown(); });
+		return d;
+	}();
+	return *dispatcher;
+}
+
+inline sw::budget_overrun_dispatcher::budget_overrun_dispatcher() :
+	m_queue(STOPWATCH_BUDGET_OVERRUN_QUEUE_CAPACITY),
+	m_lost(0),
+	m_shut_down(false),
+	m_dispatch_mutex(),
+	m_worker(&dispatch, this)
+{
+}
+
+inline void sw::budget_overrun_dispatcher::submit(budget_overrun_callback callback, const budget_overrun& overrun) noexcept
+{
+	if (m_shut_down.load())
+	{
+		// background thread is gone, call back synchronously
+		try
+		{
+			std::lock_guard<std::mutex> lock(m_dispatch_mutex);
+			callback(overrun);
+		}
+		catch (...)
+		{
+		}
+		return;
+	}
+	if (!m_queue.try_push(entry{callback, overrun}))
+	{
+		m_lost.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	// shutdown may have drained the queue between the check above and the push
+	if (m_shut_down.load())
+	{
+		try
+		{
+			flush();
+		}
+		catch (...)
+		{
+		}
+	}
+	else
+		m_worker.signal();
+}
+
+inline void sw::budget_overrun_dispatcher::flush()
+{
+	std::lock_guard<std::mutex> lock(m_dispatch_mutex);
+	drain();
+}
+
+inline std::size_t sw::budget_overrun_dispatcher::dispatch(void* dispatcher)
+{
+	budget_overrun_dispatcher& d = *static_cast<budget_overrun_dispatcher*>(dispatcher);
+	std::lock_guard<std::mutex> lock(d.m_dispatch_mutex);
+	return d.drain();
+}
+
+inline std::size_t sw::budget_overrun_dispatcher::drain() noexcept
+{
+	std::size_t count = 0;
+	entry e;
+	while (m_queue.try_pop(e))
+	{
+		// a throwing callback must not take the dispatcher thread down
+		try
+		{
+			e.callback(e.overrun);
+		}
+		catch (...)
+		{
+		}
+		++count;
+	}
+	return count;
+}
+
+inline void sw::budget_overrun_dispatcher::shutdown()
+{
+	m_worker.stop();
+	std::lock_guard<std::mutex> lock(m_dispatch_mutex);
+	m_shut_down.store(true);
+	drain();
+	if (lost() != 0)
+		std::fprintf(stderr, "stopwatch: %llu budget overrun callbacks lost due to a full queue\n", static_cast<unsigned long long>(lost()));
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+template <typename budget_duration>
+inline sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::basic_budget_stopwatch(const budget_duration& budget, std::string_view name, budget_stats* stats,
+																																			budget_overrun_callback callback, void* context) :
+	base_t(name),
+	m_budget(as<clock_duration_t>(budget)),
+	m_stats(stats),
+	m_callback(callback),
+	m_context(context),
+	m_running(auto_start_on_construction),
+	m_checked(false)
+{
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+inline sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::~basic_budget_stopwatch()
+{
+	if constexpr (check_at_destruction)
+	{
+		if (!m_checked)
+			check();
+	}
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+inline typename sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::clock_time_point_t sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::start()
+{
+	m_running = true;
+	m_checked = false;
+	return base_t::start();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+inline typename sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::clock_time_point_t sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::resume()
+{
+	m_running = true;
+	return base_t::resume();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+inline typename sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::clock_time_point_t sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::stop()
+{
+	if (!m_running)
+		return base_t::last_time_point();
+	m_running = false;
+	return base_t::stop();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+inline bool sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::check()
+{
+	stop();
+	m_checked = true;
+	if constexpr (!stopwatch_enabled)
+		return true;
+	const clock_duration_t elapsed = base_t::elapsed_clock();
+	const std::chrono::nanoseconds overrun = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed - m_budget);
+	if (m_stats)
+		m_stats->record(overrun);
+	if (elapsed <= m_budget)
+		return true;
+	if (m_callback)
+	{
+		budget_overrun o;
+		const std::string_view n = base_t::name();
+		o.name_length = static_cast<std::uint8_t>(std::min(n.size(), budget_overrun::max_name_length));
+		std::copy_n(n.data(), o.name_length, o.name_data);
+		o.budget = as<nanoseconds_d>(m_budget);
+		o.elapsed = as<nanoseconds_d>(elapsed);
+		o.context = m_context;
+		budget_overrun_dispatcher::instance().submit(m_callback, o);
+	}
+	return false;
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool check_at_destruction>
+inline typename sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::clock_duration_t sw::basic_budget_stopwatch<clock_type, report_duration, auto_start_on_construction, check_at_destruction>::remaining_clock() const
+{
+	clock_duration_t used = base_t::elapsed_clock();
+	if constexpr (stopwatch_enabled)
+	{
+		if (m_running)
+			used += clock_t::now() - base_t::last_time_point();
+	}
+	return m_budget - used;
+}
+
+#endif
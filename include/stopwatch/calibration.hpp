@@ -0,0 +1,201 @@
+#ifndef _STOPWATCH_CALIBRATION_HPP_
+#define _STOPWATCH_CALIBRATION_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+
+namespace sw
+{
+	// measured properties of a clock
+	struct clock_calibration
+	{
+		nanoseconds_d overhead{0.0};	// mean cost of one call to now()
+		nanoseconds_d resolution{0.0};	// smallest observed non-zero difference between two readings
+		nanoseconds_d bias{0.0};		// median reading of an empty section, i.e. of two back-to-back calls to now()
+		std::size_t samples = 0;
+
+		/**
+			* @brief Prints overhead, resolution and bias on a single line.
+			* @param s		Output stream.
+			* @param name	Name printed in front of the values.
+		*/
+		template <typename ostrm>
+		void report(ostrm& s, std::string_view name = {}) const;
+	};
+
+	/**
+		* @brief Measures the overhead, resolution and bias of a clock.
+		* @param samples	Number of back-to-back readings.
+		* @return			Calibration results.
+	*/
+	template <typename clock_type>
+	clock_calibration calibrate_clock(std::size_t samples = 10000);
+
+	/**
+		* @brief Returns the calibration of a clock, measured once on the first call.
+		* @return Calibration results.
+	*/
+	template <typename clock_type>
+	const clock_calibration& clock_calibration_of();
+
+	/**
+		* @brief Calibrates high_resolution_clock, system_clock, steady_clock, cpu_clock, tsc_clock and the available posix clocks (if not done before)
+		*		 and prints the results, one line per clock.
+	*/
+	template <typename ostrm>
+	void report_clock_calibrations(ostrm& s);
+
+	// Reads clock_type, but stopwatches using it subtract the calibrated bias of clock_type from every measured interval.
+	// Intervals shorter than the bias are counted as zero. The bias is calibrated by a static initializer before main(),
+	// which costs a few ms per clock type at startup but keeps calibration off the first measurement. Stopwatches used
+	// during static initialization of other translation units may see a zero bias unless they call calibrate() first.
+	template <typename clock_type>
+	struct bias_corrected_clock
+	{
+		using base_clock_t = clock_type;
+		using rep = typename clock_type::rep;
+		using period = typename clock_type::period;
+		using duration = typename clock_type::duration;
+		using time_point = std::chrono::time_point<bias_corrected_clock, duration>;
+
+		static constexpr bool is_steady = clock_type::is_steady;
+
+		static time_point now() noexcept
+		{
+			return time_point{clock_type::now().time_since_epoch()};
+		}
+
+		/**
+			* @brief Returns the bias subtracted from every interval, zero until calibrated.
+		*/
+		static duration bias() noexcept
+		{
+			static_cast<void>(s_calibrated);
+			return s_bias.load(std::memory_order_relaxed);
+		}
+
+		/**
+			* @brief Calibrates the bias if not done before. Only needed before main(), afterwards the bias is calibrated already.
+			* @return Bias subtracted from every interval.
+		*/
+		static duration calibrate()
+		{
+			const duration b = as<duration>(clock_calibration_of<clock_type>().bias);
+			s_bias.store(b, std::memory_order_relaxed);
+			return b;
+		}
+
+	private:
+		inline static std::atomic<duration> s_bias{duration::zero()};
+		inline static const bool s_calibrated = (calibrate(), true);
+	};
+
+	using hres_bias_corrected_clock = bias_corrected_clock<std::chrono::high_resolution_clock>;
+	using sys_bias_corrected_clock 	= bias_corrected_clock<std::chrono::system_clock>;
+	using cpu_bias_corrected_clock 	= bias_corrected_clock<cpu_clock>;
+	using tsc_bias_corrected_clock 	= bias_corrected_clock<tsc_clock>;
+}
+
+// --- implementation ---
+
+template <typename ostrm>
+inline void sw::clock_calibration::report(ostrm& s, std::string_view name) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const nanoseconds_d& d)
+	{
+		const char* const end = sw::format_duration(buffer, d);
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	s << name;
+	field("overhead ", overhead);
+	field(", resolution ", resolution);
+	field(", bias ", bias);
+	s << ", samples " << samples << std::endl;
+}
+
+template <typename clock_type>
+inline sw::clock_calibration sw::calibrate_clock(std::size_t samples)
+{
+	using duration = typename clock_type::duration;
+	samples = std::max<std::size_t>(samples, 1);
+	clock_calibration c;
+	c.samples = samples;
+
+	// overhead: mean cost of many consecutive calls, measured with steady_clock since coarse clocks can not time themselves
+	{
+		static_cast<void>(clock_type::now());	// lazily initialized clocks, e.g. tsc_clock, calibrate on the first call
+		const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		for (std::size_t i = 0; i < samples; ++i)
+			static_cast<void>(clock_type::now());
+		const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		c.overhead = as<nanoseconds_d>(t1 - t0) / static_cast<double>(samples);
+	}
+
+	// bias: what a stopwatch reports for an empty section
+	{
+		std::vector<duration> deltas(samples);
+		for (std::size_t i = 0; i < samples; ++i)
+		{
+			const typename clock_type::time_point t0 = clock_type::now();
+			const typename clock_type::time_point t1 = clock_type::now();
+			deltas[i] = t1 - t0;
+		}
+		std::nth_element(deltas.begin(), deltas.begin() + static_cast<std::ptrdiff_t>(samples / 2), deltas.end());
+		c.bias = as<nanoseconds_d>(deltas[samples / 2]);
+	}
+
+	// resolution: smallest step between distinct readings, sampling a few ticks but spinning at most 50 ms
+	{
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+		duration smallest = duration::max();
+		typename clock_type::time_point previous = clock_type::now();
+		for (int ticks = 0; ticks < 16 && std::chrono::steady_clock::now() < deadline;)
+		{
+			const typename clock_type::time_point current = clock_type::now();
+			if (current != previous)
+			{
+				if (current > previous)
+					smallest = std::min(smallest, current - previous);
+				previous = current;
+				++ticks;
+			}
+		}
+		c.resolution = smallest == duration::max() ? nanoseconds_d::zero() : as<nanoseconds_d>(smallest);
+	}
+	return c;
+}
+
+template <typename clock_type>
+inline const sw::clock_calibration& sw::clock_calibration_of()
+{
+	static const clock_calibration calibration = calibrate_clock<clock_type>();
+	return calibration;
+}
+
+template <typename ostrm>
+inline void sw::report_clock_calibrations(ostrm& s)
+{
+	clock_calibration_of<std::chrono::high_resolution_clock>().report(s, "high_resolution_clock: ");
+	clock_calibration_of<std::chrono::system_clock>().report(s, "system_clock: ");
+	clock_calibration_of<std::chrono::steady_clock>().report(s, "steady_clock: ");
+	clock_calibration_of<cpu_clock>().report(s, "cpu_clock: ");
+	clock_calibration_of<tsc_clock>().report(s, "tsc_clock: ");
+#if STOPWATCH_HAS_MONOTONIC_COARSE_CLOCK
+	clock_calibration_of<monotonic_coarse_clock>().report(s, "monotonic_coarse_clock: ");
+#endif
+#if STOPWATCH_HAS_MONOTONIC_RAW_CLOCK
+	clock_calibration_of<monotonic_raw_clock>().report(s, "monotonic_raw_clock: ");
+#endif
+#if STOPWATCH_HAS_BOOTTIME_CLOCK
+	clock_calibration_of<boottime_clock>().report(s, "boottime_clock: ");
+#endif
+}
+
+#endif
@@ -2,6 +2,12 @@
 #define _STOPWATCH_COMMON_HPP_
 
 #include <chrono>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace sw
 {
@@ -52,6 +58,35 @@ namespace sw
 		static constexpr const char* str() noexcept;
 	};
 
+	// maximum number of characters written by format_duration
+	inline constexpr std::size_t max_duration_str_length = 48;
+
+	/**
+		* @brief Writes a number into a character buffer. Floating point values are formatted like std::ostream's
+		*		 default formatting (%g).
+		* @param first	Begin of the output buffer. Must hold at least max_duration_str_length characters.
+		* @param value	Number to format.
+		* @return		Pointer past the last written character. The output is not null terminated.
+	*/
+	template <typename rep>
+	inline char* format_count(char* first, rep value) noexcept;
+
+	/**
+		* @brief Writes the count of a duration followed by a space and its unit postfix into a character buffer.
+		*		 Floating point counts are formatted like std::ostream's default formatting (%g).
+		* @param first	Begin of the output buffer. Must hold at least max_duration_str_length characters.
+		* @param d		Duration to format.
+		* @return		Pointer past the last written character. The output is not null terminated.
+	*/
+	template <typename duration_type>
+	inline char* format_duration(char* first, const duration_type& d) noexcept;
+
+	namespace detail
+	{
+		// appends str as a quoted and escaped json string
+		inline void append_json_string(std::string& out, std::string_view str);
+	}
+
 	// shorter duration casts
 	template <typename desired_duration_type, typename input_duration_type>
 	inline constexpr desired_duration_type as(const input_duration_type& d) noexcept;
@@ -77,6 +112,60 @@ inline constexpr const char* sw::time_unit_postfix<std::chrono::duration<rep, pe
 		return "";
 }
 
+template <typename rep>
+inline char* sw::format_count(char* first, rep value) noexcept
+{
+	char* const last = first + max_duration_str_length;
+	if constexpr (std::is_floating_point_v<rep>)
+	{
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+		return std::to_chars(first, last, value, std::chars_format::general, 6).ptr;
+#else
+		const int n = std::snprintf(first, static_cast<std::size_t>(last - first), "%g", static_cast<double>(value));
+		return first + (n > 0 ? n : 0);
+#endif
+	}
+	else
+	{
+		return std::to_chars(first, last, value).ptr;
+	}
+}
+
+template <typename duration_type>
+inline char* sw::format_duration(char* first, const duration_type& d) noexcept
+{
+	char* const last = first + max_duration_str_length;
+	char* it = sw::format_count(first, d.count());
+	if (it != last)
+		*it++ = ' ';
+	for (const char* postfix = sw::time_unit_postfix<duration_type>::str(); *postfix != '\0' && it != last; ++postfix)
+		*it++ = *postfix;
+	return it;
+}
+
+inline void sw::detail::append_json_string(std::string& out, std::string_view str)
+{
+	static constexpr char hex[] = "0123456789abcdef";
+	out += '"';
+	for (const char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			out += "\\u00";
+			out += hex[(c >> 4) & 0xf];
+			out += hex[c & 0xf];
+		}
+		else
+			out += c;
+	}
+	out += '"';
+}
+
 template <typename desired_duration_type, typename input_duration_type>
 inline constexpr desired_duration_type sw::as(const input_duration_type& d) noexcept
 {
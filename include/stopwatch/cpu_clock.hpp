@@ -3,11 +3,32 @@
 
 #include <chrono>
 #include <cstdint>
+#include <ctime>
 #include <type_traits>
 
 #define STOPWATCH_CPU_CLOCK_TYPE_DEFAULT 0
 #define STOPWATCH_CPU_CLOCK_TYPE_POSIX 1
 #define STOPWATCH_CPU_CLOCK_TYPE_WINAPI_PERF_COUNTER 2
+#define STOPWATCH_CPU_CLOCK_TYPE_TSC 3
+
+// time stamp counter intrinsics are available on x86 with gcc, clang and msvc
+#if !defined(STOPWATCH_HAS_TSC) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+        #define STOPWATCH_HAS_TSC 1
+    #elif defined(__GNUC__) && __has_include(<x86intrin.h>) && __has_include(<cpuid.h>)
+        #include <x86intrin.h>
+        #include <cpuid.h>
+        #define STOPWATCH_HAS_TSC 1
+    #endif
+#endif
+#if !defined(STOPWATCH_HAS_TSC)
+    #define STOPWATCH_HAS_TSC 0
+#endif
+// duration of the busy wait used to calibrate the time stamp counter against std::chrono::steady_clock
+#if !defined(STOPWATCH_TSC_CALIBRATION_TIME_MS)
+    #define STOPWATCH_TSC_CALIBRATION_TIME_MS 10
+#endif
 
 // use posix clock if available
 #if !defined(STOPWATCH_CLOCK_TYPE) && __has_include(<unistd.h>)
@@ -35,9 +56,163 @@ namespace sw
     {
         default_clock = 0,
         posix_clock = 1,
-        winapi_performance_counter = 2
+        winapi_performance_counter = 2,
+        tsc = 3
+    };
+
+    // Calibration data of the time stamp counter. Computed once on first use of a tsc clock.
+    struct tsc_calibration
+    {
+        bool invariant_tsc = false;     // cpu has a constant rate, non-stop tsc; tsc clocks fall back to steady_clock otherwise
+        bool has_rdtscp = false;        // cpu supports the rdtscp instruction
+        std::uint64_t tsc_base = 0;     // tsc value at calibration, corresponds to time point zero
+        std::uint64_t ns_mult = 0;      // ticks to nanoseconds factor in 32.32 fixed point
+        double ticks_per_second = 0.0;  // measured tsc frequency
+
+        /**
+            * @brief Returns the process wide calibration data, calibrating on the first call.
+            * @return Calibration data.
+        */
+        static const tsc_calibration& get() noexcept
+        {
+            static const tsc_calibration calibration = calibrate();
+            return calibration;
+        }
+
+    private:
+        static tsc_calibration calibrate() noexcept
+        {
+            tsc_calibration c;
+#if STOPWATCH_HAS_TSC
+            // invariant tsc: CPUID.80000007H:EDX[8], rdtscp: CPUID.80000001H:EDX[27]
+    #if defined(_MSC_VER)
+            int regs[4]{};
+            __cpuid(regs, 0x80000000);
+            const unsigned int max_ext_leaf = static_cast<unsigned int>(regs[0]);
+            if (max_ext_leaf >= 0x80000001u)
+            {
+                __cpuid(regs, 0x80000001);
+                c.has_rdtscp = (regs[3] >> 27) & 1;
+            }
+            if (max_ext_leaf >= 0x80000007u)
+            {
+                __cpuid(regs, 0x80000007);
+                c.invariant_tsc = (regs[3] >> 8) & 1;
+            }
+    #else
+            unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+            if (__get_cpuid(0x80000001u, &eax, &ebx, &ecx, &edx))
+                c.has_rdtscp = (edx >> 27) & 1;
+            if (__get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx))
+                c.invariant_tsc = (edx >> 8) & 1;
+    #endif
+            if (!c.invariant_tsc)
+                return c;
+            // measure the tsc frequency against steady_clock
+            using steady = std::chrono::steady_clock;
+            const steady::time_point s0 = steady::now();
+            const std::uint64_t t0 = __rdtsc();
+            steady::time_point s1 = s0;
+            while (s1 - s0 < std::chrono::milliseconds(STOPWATCH_TSC_CALIBRATION_TIME_MS))
+                s1 = steady::now();
+            const std::uint64_t t1 = __rdtsc();
+            const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(s1 - s0).count());
+            if (t1 <= t0 || ns <= 0.0)
+            {
+                c.invariant_tsc = false;
+                return c;
+            }
+            c.ticks_per_second = static_cast<double>(t1 - t0) * 1.0e9 / ns;
+            c.ns_mult = static_cast<std::uint64_t>(ns / static_cast<double>(t1 - t0) * 4294967296.0 + 0.5);
+            c.tsc_base = t1;
+#endif
+            return c;
+        }
+    };
+
+    // Clock reading the time stamp counter directly. Time points are nanoseconds since calibration.
+    // The serializing variant waits for all preceding instructions (rdtscp) and keeps subsequent ones
+    // from starting early (lfence). Falls back to std::chrono::steady_clock without an invariant tsc.
+    template <bool serializing>
+    struct basic_tsc_clock
+    {
+        static constexpr CPUClockType cpu_clock_type = CPUClockType::tsc;
+        using rep = std::int64_t;
+        using period = std::nano;
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<basic_tsc_clock>;
+
+        static constexpr bool is_steady = true;
+        static constexpr bool is_serializing = serializing;
+
+        /**
+            * @brief Forces calibration, e.g. at program startup, so that the first call to now() does not pay for it.
+            * @return True if the time stamp counter is used, false if the clock falls back to steady_clock.
+        */
+        static bool calibrate() noexcept
+        {
+            return tsc_calibration::get().invariant_tsc;
+        }
+
+        /**
+            * @brief Reads the raw time stamp counter. Returns 0 if no time stamp counter is available.
+            * @return Current tsc value.
+        */
+        static std::uint64_t ticks() noexcept
+        {
+#if STOPWATCH_HAS_TSC
+            if constexpr (serializing)
+            {
+                std::uint64_t t;
+                if (tsc_calibration::get().has_rdtscp)
+                {
+                    unsigned int aux;
+                    t = __rdtscp(&aux);
+                }
+                else
+                {
+                    _mm_lfence();
+                    t = __rdtsc();
+                }
+                _mm_lfence();
+                return t;
+            }
+            else
+            {
+                return __rdtsc();
+            }
+#else
+            return 0;
+#endif
+        }
+
+        static time_point now() noexcept
+        {
+            const tsc_calibration& c = tsc_calibration::get();
+            if (!c.invariant_tsc)
+            {
+                return time_point{std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch())};
+            }
+            // readings below the calibration base, e.g. from a core with a slightly offset tsc, give negative time points
+            const std::int64_t delta = static_cast<std::int64_t>(ticks() - c.tsc_base);
+            const std::uint64_t magnitude = delta < 0 ? 0 - static_cast<std::uint64_t>(delta) : static_cast<std::uint64_t>(delta);
+#if defined(_MSC_VER) && defined(_M_X64)
+            std::uint64_t high;
+            const std::uint64_t low = _umul128(magnitude, c.ns_mult, &high);
+            const rep ns = static_cast<rep>(__shiftright128(low, high, 32));
+#elif defined(__SIZEOF_INT128__)
+            __extension__ typedef unsigned __int128 uint128;
+            const rep ns = static_cast<rep>((static_cast<uint128>(magnitude) * c.ns_mult) >> 32);
+#else
+            const rep ns = static_cast<rep>(static_cast<double>(magnitude) * (static_cast<double>(c.ns_mult) / 4294967296.0));
+#endif
+            return time_point{duration{delta < 0 ? -ns : ns}};
+        }
     };
 
+    using tsc_clock = basic_tsc_clock<false>;
+    using tsc_clock_serializing = basic_tsc_clock<true>;
+
 #if STOPWATCH_CLOCK_TYPE == STOPWATCH_CPU_CLOCK_TYPE_DEFAULT
     struct cpu_clock
     {
@@ -98,7 +273,128 @@ namespace sw
             return time_point{ duration{static_cast<rep>((li.QuadPart * 1000000000) / frequency.QuadPart)}};
         }
     };  
+#elif STOPWATCH_CLOCK_TYPE == STOPWATCH_CPU_CLOCK_TYPE_TSC
+    using cpu_clock = tsc_clock;
 #endif     
+
+    // Clock measuring the cpu time consumed by the calling thread. Readings of different threads are not comparable.
+    // Falls back to std::clock(), i.e. process cpu time on posix systems, where no thread cpu time is available.
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+    struct thread_cpu_clock
+    {
+        using rep = std::int64_t;
+        using period = std::nano;
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<thread_cpu_clock>;
+
+        static constexpr bool is_steady = true;
+        static constexpr bool is_thread_time = true;
+
+        static time_point now() noexcept
+        {
+            timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return time_point{duration{static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec}};
+        }
+    };
+#elif STOPWATCH_CLOCK_TYPE == STOPWATCH_CPU_CLOCK_TYPE_WINAPI_PERF_COUNTER
+    struct thread_cpu_clock
+    {
+        using rep = std::int64_t;
+        using period = std::ratio<1, 10000000>;
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<thread_cpu_clock>;
+
+        static constexpr bool is_steady = true;
+        static constexpr bool is_thread_time = true;
+
+        static time_point now() noexcept
+        {
+            // kernel plus user time in 100 ns units
+            FILETIME creation, exit, kernel, user;
+            GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+            const rep k = (static_cast<rep>(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+            const rep u = (static_cast<rep>(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+            return time_point{duration{k + u}};
+        }
+    };
+#else
+    struct thread_cpu_clock
+    {
+        using rep = decltype(std::clock());
+        using period = std::ratio<1, CLOCKS_PER_SEC>;
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<thread_cpu_clock>;
+
+        static constexpr bool is_steady = true;
+        static constexpr bool is_thread_time = false;
+
+        static time_point now() noexcept
+        {
+            return time_point{duration{std::clock()}};
+        }
+    };
+#endif
+
+    // Wall clock reading a posix clock id with clock_gettime, e.g. CLOCK_MONOTONIC_COARSE.
+#if defined(CLOCK_MONOTONIC)
+    template <clockid_t id>
+    struct basic_posix_clock
+    {
+        using rep = std::int64_t;
+        using period = std::nano;
+        using duration = std::chrono::duration<rep, period>;
+        using time_point = std::chrono::time_point<basic_posix_clock>;
+
+        static constexpr bool is_steady = true;
+        static constexpr clockid_t clock_id = id;
+
+        static time_point now() noexcept
+        {
+            timespec ts;
+            clock_gettime(id, &ts);
+            return time_point{duration{static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec}};
+        }
+
+        /**
+            * @brief Returns the resolution the system reports for the clock, zero if it can not be queried.
+            * @return Resolution of the clock.
+        */
+        static duration resolution() noexcept
+        {
+            timespec ts;
+            if (clock_getres(id, &ts) != 0)
+                return duration::zero();
+            return duration{static_cast<rep>(ts.tv_sec) * 1000000000 + ts.tv_nsec};
+        }
+    };
+#endif
+
+    // Clocks for the linux clock ids; each one is std::chrono::steady_clock where its clock id is not available.
+    // monotonic_coarse_clock: monotonic time of the last scheduler tick, very cheap to read but only a few ms resolution.
+    // monotonic_raw_clock: monotonic time of the hardware counter, not slewed by ntp adjustments.
+    // boottime_clock: monotonic time that, unlike steady_clock, keeps counting while the system is suspended.
+#if defined(CLOCK_MONOTONIC) && defined(CLOCK_MONOTONIC_COARSE)
+    #define STOPWATCH_HAS_MONOTONIC_COARSE_CLOCK 1
+    using monotonic_coarse_clock = basic_posix_clock<CLOCK_MONOTONIC_COARSE>;
+#else
+    #define STOPWATCH_HAS_MONOTONIC_COARSE_CLOCK 0
+    using monotonic_coarse_clock = std::chrono::steady_clock;
+#endif
+#if defined(CLOCK_MONOTONIC) && defined(CLOCK_MONOTONIC_RAW)
+    #define STOPWATCH_HAS_MONOTONIC_RAW_CLOCK 1
+    using monotonic_raw_clock = basic_posix_clock<CLOCK_MONOTONIC_RAW>;
+#else
+    #define STOPWATCH_HAS_MONOTONIC_RAW_CLOCK 0
+    using monotonic_raw_clock = std::chrono::steady_clock;
+#endif
+#if defined(CLOCK_MONOTONIC) && defined(CLOCK_BOOTTIME)
+    #define STOPWATCH_HAS_BOOTTIME_CLOCK 1
+    using boottime_clock = basic_posix_clock<CLOCK_BOOTTIME>;
+#else
+    #define STOPWATCH_HAS_BOOTTIME_CLOCK 0
+    using boottime_clock = std::chrono::steady_clock;
+#endif
 }
 
 #endif
\ No newline at end of file
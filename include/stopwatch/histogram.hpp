@@ -0,0 +1,437 @@
+#ifndef _STOPWATCH_HISTOGRAM_HPP_
+#define _STOPWATCH_HISTOGRAM_HPP_
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+namespace sw
+{
+	namespace detail
+	{
+		// number of leading zero bits, v must not be zero
+		inline int countl_zero64(std::uint64_t v) noexcept
+		{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+			unsigned long index;
+			_BitScanReverse64(&index, v);
+			return 63 - static_cast<int>(index);
+#elif defined(__GNUC__)
+			return __builtin_clzll(v);
+#else
+			int n = 0;
+			for (std::uint64_t mask = std::uint64_t{1} << 63; (v & mask) == 0; mask >>= 1)
+				++n;
+			return n;
+#endif
+		}
+	}
+
+	/*
+		Latency histogram with HdrHistogram bucketing. Values are tracked with a fixed number of significant
+		decimal digits across the whole range from lowest_discernible to highest_trackable: each power of two
+		range ("bucket") is linearly divided into the same number of sub buckets. Memory is allocated once at
+		construction, recording is a few shifts and an increment. Values outside the trackable range are clamped.
+		Not thread safe; use one histogram per thread and merge().
+	*/
+	template <typename duration_type = std::chrono::nanoseconds>
+	class basic_latency_histogram
+	{
+	public:
+		using duration_t = duration_type;
+		static_assert(std::is_integral_v<typename duration_t::rep>, "basic_latency_histogram requires an integral duration type");
+
+		/**
+			* @brief Creates a new histogram.
+			* @param lowest_discernible		Smallest value that is distinguished from zero. At least 1.
+			* @param highest_trackable		Largest value that can be recorded. At least 2 * lowest_discernible.
+			* @param significant_figures	Number of significant decimal digits kept for every value, in [1, 5].
+		*/
+		explicit basic_latency_histogram(duration_t lowest_discernible = duration_t{1},
+										 duration_t highest_trackable = as<duration_t>(std::chrono::hours(1)),
+										 int significant_figures = 3);
+		/**
+			* @brief Records a value. Negative values are recorded as zero, values above highest_trackable() as highest_trackable().
+			* @param d		Value to record, duration_cast'ed into the histogram's duration type.
+			* @param count	Number of times the value is recorded.
+		*/
+		template <typename input_duration_type>
+		void record(const input_duration_type& d, std::uint64_t count = 1) noexcept;
+		/**
+			* @brief Adds all values of another histogram. Histograms with a different layout are merged bucket by
+			*		 bucket at the resolution of this histogram.
+			* @param other	Histogram to merge.
+		*/
+		void merge(const basic_latency_histogram& other);
+		/**
+			* @brief Removes all recorded values.
+		*/
+		void reset() noexcept;
+		/**
+			* @brief Returns the number of recorded values.
+			* @return Total count.
+		*/
+		std::uint64_t total_count() const noexcept { return m_total_count; }
+		/**
+			* @brief Returns the smallest recorded value (after clamping), or zero if empty.
+			* @return Minimum value.
+		*/
+		duration_t min() const noexcept;
+		/**
+			* @brief Returns the largest recorded value (after clamping), or zero if empty.
+			* @return Maximum value.
+		*/
+		duration_t max() const noexcept;
+		/**
+			* @brief Returns the mean of all recorded values at histogram resolution, or zero if empty.
+			* @return Mean value.
+		*/
+		duration_t mean() const noexcept;
+		/**
+			* @brief Returns the value below or at which the given percentage of recorded values lie.
+			*		 The result is the highest value equivalent to the bucket that contains the percentile.
+			* @param p	Percentile in [0, 100].
+			* @return	Value at percentile, zero if empty.
+		*/
+		duration_t value_at_percentile(double p) const noexcept;
+		/**
+			* @brief Returns the number of recorded values equivalent to the given value at histogram resolution.
+			* @param d	Value.
+			* @return	Count of the bucket the value falls into.
+		*/
+		std::uint64_t count_at(duration_t d) const noexcept;
+		/**
+			* @brief Returns the lowest value that falls into the same bucket as the given value.
+		*/
+		duration_t lowest_equivalent(duration_t d) const noexcept;
+		/**
+			* @brief Returns the highest value that falls into the same bucket as the given value.
+		*/
+		duration_t highest_equivalent(duration_t d) const noexcept;
+		/// Returns the lowest discernible value.
+		duration_t lowest_discernible() const noexcept { return duration_t{static_cast<typename duration_t::rep>(m_lowest_discernible)}; }
+		/// Returns the highest trackable value.
+		duration_t highest_trackable() const noexcept { return duration_t{static_cast<typename duration_t::rep>(m_highest_trackable)}; }
+		/// Returns the number of significant decimal digits.
+		int significant_figures() const noexcept { return m_significant_figures; }
+		/// Returns the number of bytes used by the bucket counters.
+		std::size_t memory_size() const noexcept { return m_counts.size() * sizeof(std::uint64_t); }
+		/**
+			* @brief Prints count, min, mean, p50, p90, p99, p99.9, p99.99 and max on a single line.
+			* @tparam report_duration	Duration type used for printing.
+			* @param s					Output stream.
+			* @param name				Name printed in front of the values.
+		*/
+		template <typename ostrm, typename report_duration = duration_t>
+		void report(ostrm& s, std::string_view name = {}) const;
+
+	private:
+		std::size_t counts_index_for(std::uint64_t value) const noexcept;
+		std::uint64_t value_from_index(std::size_t index) const noexcept;
+		std::uint64_t size_of_equivalent_range(std::uint64_t value) const noexcept;
+		std::uint64_t lowest_equivalent_value(std::uint64_t value) const noexcept;
+		std::uint64_t highest_equivalent_value(std::uint64_t value) const noexcept;
+		bool same_layout(const basic_latency_histogram& other) const noexcept;
+
+		std::uint64_t m_lowest_discernible;
+		std::uint64_t m_highest_trackable;
+		int m_significant_figures;
+		int m_unit_magnitude;
+		int m_sub_bucket_half_count_magnitude;
+		std::uint64_t m_sub_bucket_half_count;
+		std::uint64_t m_sub_bucket_mask;
+		std::uint64_t m_total_count;
+		std::uint64_t m_min;
+		std::uint64_t m_max;
+		std::vector<std::uint64_t> m_counts;
+	};
+
+	using latency_histogram = basic_latency_histogram<std::chrono::nanoseconds>;
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		// stopwatch that starts on construction and records its elapsed time into a histogram on destruction
+		template <typename clock_type, typename histogram_type = latency_histogram>
+		class basic_histogram_stopwatch : public basic_stopwatch<clock_type, typename histogram_type::duration_t, true, false>
+		{
+		public:
+			using base_t = basic_stopwatch<clock_type, typename histogram_type::duration_t, true, false>;
+			using histogram_t = histogram_type;
+
+			/**
+				* @brief Creates and starts a new basic_histogram_stopwatch.
+				* @param histogram	Histogram the elapsed time is recorded into. Must outlive the stopwatch.
+				* @param name		Name of the stopwatch.
+			*/
+			explicit basic_histogram_stopwatch(histogram_t& histogram, std::string_view name = {}) : base_t(name), m_histogram(histogram) {}
+			basic_histogram_stopwatch(const basic_histogram_stopwatch&) = delete;
+			basic_histogram_stopwatch& operator=(const basic_histogram_stopwatch&) = delete;
+			/// Destructor. Stops the stopwatch and records the elapsed time.
+			~basic_histogram_stopwatch()
+			{
+				if constexpr (stopwatch_enabled)
+				{
+					base_t::stop();
+					m_histogram.record(base_t::elapsed_clock());
+				}
+			}
+
+		private:
+			histogram_t& m_histogram;
+		};
+	}
+
+	using hres_histogram_stopwatch 	= basic_histogram_stopwatch<std::chrono::high_resolution_clock>;
+	using sys_histogram_stopwatch 	= basic_histogram_stopwatch<std::chrono::system_clock>;
+	using cpu_histogram_stopwatch 	= basic_histogram_stopwatch<cpu_clock>;
+	using tsc_histogram_stopwatch 	= basic_histogram_stopwatch<tsc_clock>;
+}
+
+// --- implementation ---
+
+template <typename duration_type>
+inline sw::basic_latency_histogram<duration_type>::basic_latency_histogram(duration_t lowest_discernible, duration_t highest_trackable, int significant_figures) :
+	m_lowest_discernible(static_cast<std::uint64_t>(std::max<typename duration_t::rep>(lowest_discernible.count(), 1))),
+	m_highest_trackable(0),
+	m_significant_figures(std::clamp(significant_figures, 1, 5)),
+	m_unit_magnitude(0),
+	m_sub_bucket_half_count_magnitude(0),
+	m_sub_bucket_half_count(0),
+	m_sub_bucket_mask(0),
+	m_total_count(0),
+	m_min(0),
+	m_max(0),
+	m_counts()
+{
+	m_highest_trackable = std::max(static_cast<std::uint64_t>(std::max<typename duration_t::rep>(highest_trackable.count(), 0)), 2 * m_lowest_discernible);
+	// values up to 2 * 10^significant_figures are tracked with unit resolution
+	std::uint64_t largest_single_unit_value = 2;
+	for (int i = 0; i < m_significant_figures; ++i)
+		largest_single_unit_value *= 10;
+	const int sub_bucket_count_magnitude = 64 - detail::countl_zero64(largest_single_unit_value - 1);
+	m_sub_bucket_half_count_magnitude = std::max(sub_bucket_count_magnitude, 1) - 1;
+	m_unit_magnitude = 63 - detail::countl_zero64(m_lowest_discernible);
+	const std::uint64_t sub_bucket_count = std::uint64_t{1} << (m_sub_bucket_half_count_magnitude + 1);
+	m_sub_bucket_half_count = sub_bucket_count / 2;
+	m_sub_bucket_mask = (sub_bucket_count - 1) << m_unit_magnitude;
+	// number of power of two buckets needed to cover the highest trackable value
+	std::uint64_t smallest_untrackable = sub_bucket_count << m_unit_magnitude;
+	std::size_t bucket_count = 1;
+	while (smallest_untrackable <= m_highest_trackable)
+	{
+		if (smallest_untrackable > (std::uint64_t{1} << 62))
+		{
+			++bucket_count;
+			break;
+		}
+		smallest_untrackable <<= 1;
+		++bucket_count;
+	}
+	m_counts.assign((bucket_count + 1) * static_cast<std::size_t>(m_sub_bucket_half_count), 0);
+	reset();
+}
+
+template <typename duration_type>
+template <typename input_duration_type>
+inline void sw::basic_latency_histogram<duration_type>::record(const input_duration_type& d, std::uint64_t count) noexcept
+{
+	const typename duration_t::rep v = as<duration_t>(d).count();
+	const std::uint64_t value = std::min(static_cast<std::uint64_t>(std::max<typename duration_t::rep>(v, 0)), m_highest_trackable);
+	m_counts[counts_index_for(value)] += count;
+	m_total_count += count;
+	m_min = std::min(m_min, value);
+	m_max = std::max(m_max, value);
+}
+
+template <typename duration_type>
+inline void sw::basic_latency_histogram<duration_type>::merge(const basic_latency_histogram& other)
+{
+	if (other.m_total_count == 0)
+		return;
+	if (same_layout(other))
+	{
+		for (std::size_t i = 0; i < m_counts.size(); ++i)
+			m_counts[i] += other.m_counts[i];
+		m_total_count += other.m_total_count;
+		m_min = std::min(m_min, other.m_min);
+		m_max = std::max(m_max, other.m_max);
+		return;
+	}
+	// recording bucket values moves the extrema to bucket boundaries, restore the exact ones afterwards
+	const std::uint64_t min = m_min;
+	const std::uint64_t max = m_max;
+	for (std::size_t i = 0; i < other.m_counts.size(); ++i)
+	{
+		if (other.m_counts[i] != 0)
+			record(duration_t{static_cast<typename duration_t::rep>(other.value_from_index(i))}, other.m_counts[i]);
+	}
+	m_min = std::min(min, std::min(other.m_min, m_highest_trackable));
+	m_max = std::max(max, std::min(other.m_max, m_highest_trackable));
+}
+
+template <typename duration_type>
+inline void sw::basic_latency_histogram<duration_type>::reset() noexcept
+{
+	std::fill(m_counts.begin(), m_counts.end(), std::uint64_t{0});
+	m_total_count = 0;
+	m_min = ~std::uint64_t{0};
+	m_max = 0;
+}
+
+template <typename duration_type>
+inline typename sw::basic_latency_histogram<duration_type>::duration_t sw::basic_latency_histogram<duration_type>::min() const noexcept
+{
+	return duration_t{static_cast<typename duration_t::rep>(m_total_count == 0 ? 0 : m_min)};
+}
+
+template <typename duration_type>
+inline typename sw::basic_latency_histogram<duration_type>::duration_t sw::basic_latency_histogram<duration_type>::max() const noexcept
+{
+	return duration_t{static_cast<typename duration_t::rep>(m_max)};
+}
+
+template <typename duration_type>
+inline typename sw::basic_latency_histogram<duration_type>::duration_t sw::basic_latency_histogram<duration_type>::mean() const noexcept
+{
+	if (m_total_count == 0)
+		return duration_t::zero();
+	// each bucket contributes with the median of its equivalent value range
+	double sum = 0.0;
+	for (std::size_t i = 0; i < m_counts.size(); ++i)
+	{
+		if (m_counts[i] != 0)
+		{
+			const std::uint64_t value = value_from_index(i);
+			sum += static_cast<double>(m_counts[i]) * static_cast<double>(lowest_equivalent_value(value) + (size_of_equivalent_range(value) >> 1));
+		}
+	}
+	return duration_t{static_cast<typename duration_t::rep>(sum / static_cast<double>(m_total_count))};
+}
+
+template <typename duration_type>
+inline typename sw::basic_latency_histogram<duration_type>::duration_t sw::basic_latency_histogram<duration_type>::value_at_percentile(double p) const noexcept
+{
+	if (m_total_count == 0)
+		return duration_t::zero();
+	const double requested = std::clamp(p, 0.0, 100.0);
+	const std::uint64_t count_at_percentile = std::max<std::uint64_t>(static_cast<std::uint64_t>(requested / 100.0 * static_cast<double>(m_total_count) + 0.5), 1);
+	std::uint64_t running = 0;
+	for (std::size_t i = 0; i < m_counts.size(); ++i)
+	{
+		running += m_counts[i];
+		if (running >= count_at_percentile)
+			return duration_t{static_cast<typename duration_t::rep>(std::min(highest_equivalent_value(value_from_index(i)), m_max))};
+	}
+	return max();
+}
+
+template <typename duration_type>
+inline std::uint64_t sw::basic_latency_histogram<duration_type>::count_at(duration_t d) const noexcept
+{
+	const std::uint64_t value = std::min(static_cast<std::uint64_t>(std::max<typename duration_t::rep>(d.count(), 0)), m_highest_trackable);
+	return m_counts[counts_index_for(value)];
+}
+
+template <typename duration_type>
+inline typename sw::basic_latency_histogram<duration_type>::duration_t sw::basic_latency_histogram<duration_type>::lowest_equivalent(duration_t d) const noexcept
+{
+	return duration_t{static_cast<typename duration_t::rep>(lowest_equivalent_value(static_cast<std::uint64_t>(std::max<typename duration_t::rep>(d.count(), 0))))};
+}
+
+template <typename duration_type>
+inline typename sw::basic_latency_histogram<duration_type>::duration_t sw::basic_latency_histogram<duration_type>::highest_equivalent(duration_t d) const noexcept
+{
+	return duration_t{static_cast<typename duration_t::rep>(highest_equivalent_value(static_cast<std::uint64_t>(std::max<typename duration_t::rep>(d.count(), 0))))};
+}
+
+template <typename duration_type>
+template <typename ostrm, typename report_duration>
+inline void sw::basic_latency_histogram<duration_type>::report(ostrm& s, std::string_view name) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const duration_t& d)
+	{
+		const char* const end = sw::format_duration(buffer, as<report_duration>(d));
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	s << name << "count " << m_total_count;
+	field(", min ", min());
+	field(", mean ", mean());
+	field(", p50 ", value_at_percentile(50.0));
+	field(", p90 ", value_at_percentile(90.0));
+	field(", p99 ", value_at_percentile(99.0));
+	field(", p99.9 ", value_at_percentile(99.9));
+	field(", p99.99 ", value_at_percentile(99.99));
+	field(", max ", max());
+	s << std::endl;
+}
+
+template <typename duration_type>
+inline std::size_t sw::basic_latency_histogram<duration_type>::counts_index_for(std::uint64_t value) const noexcept
+{
+	// power of two bucket from the position of the highest set bit, the mask keeps small values in bucket 0
+	const int pow2_ceiling = 64 - detail::countl_zero64(value | m_sub_bucket_mask);
+	const int bucket_index = pow2_ceiling - m_unit_magnitude - (m_sub_bucket_half_count_magnitude + 1);
+	const std::uint64_t sub_bucket_index = value >> (bucket_index + m_unit_magnitude);
+	// buckets above 0 only use their upper half, the lower half is covered by the previous bucket
+	const std::size_t bucket_base_index = static_cast<std::size_t>(bucket_index + 1) << m_sub_bucket_half_count_magnitude;
+	return bucket_base_index + static_cast<std::size_t>(sub_bucket_index - m_sub_bucket_half_count);
+}
+
+template <typename duration_type>
+inline std::uint64_t sw::basic_latency_histogram<duration_type>::value_from_index(std::size_t index) const noexcept
+{
+	int bucket_index = static_cast<int>(index >> m_sub_bucket_half_count_magnitude) - 1;
+	std::uint64_t sub_bucket_index = (index & (m_sub_bucket_half_count - 1)) + m_sub_bucket_half_count;
+	if (bucket_index < 0)
+	{
+		sub_bucket_index -= m_sub_bucket_half_count;
+		bucket_index = 0;
+	}
+	return sub_bucket_index << (bucket_index + m_unit_magnitude);
+}
+
+template <typename duration_type>
+inline std::uint64_t sw::basic_latency_histogram<duration_type>::size_of_equivalent_range(std::uint64_t value) const noexcept
+{
+	const int pow2_ceiling = 64 - detail::countl_zero64(value | m_sub_bucket_mask);
+	const int bucket_index = pow2_ceiling - m_unit_magnitude - (m_sub_bucket_half_count_magnitude + 1);
+	const std::uint64_t sub_bucket_index = value >> (bucket_index + m_unit_magnitude);
+	const int adjusted_bucket = sub_bucket_index >= 2 * m_sub_bucket_half_count ? bucket_index + 1 : bucket_index;
+	return std::uint64_t{1} << (m_unit_magnitude + adjusted_bucket);
+}
+
+template <typename duration_type>
+inline std::uint64_t sw::basic_latency_histogram<duration_type>::lowest_equivalent_value(std::uint64_t value) const noexcept
+{
+	const int pow2_ceiling = 64 - detail::countl_zero64(value | m_sub_bucket_mask);
+	const int bucket_index = pow2_ceiling - m_unit_magnitude - (m_sub_bucket_half_count_magnitude + 1);
+	const std::uint64_t sub_bucket_index = value >> (bucket_index + m_unit_magnitude);
+	return sub_bucket_index << (bucket_index + m_unit_magnitude);
+}
+
+template <typename duration_type>
+inline std::uint64_t sw::basic_latency_histogram<duration_type>::highest_equivalent_value(std::uint64_t value) const noexcept
+{
+	return lowest_equivalent_value(value) + size_of_equivalent_range(value) - 1;
+}
+
+template <typename duration_type>
+inline bool sw::basic_latency_histogram<duration_type>::same_layout(const basic_latency_histogram& other) const noexcept
+{
+	return m_unit_magnitude == other.m_unit_magnitude &&
+		   m_sub_bucket_half_count_magnitude == other.m_sub_bucket_half_count_magnitude &&
+		   m_counts.size() == other.m_counts.size();
+}
+
+#endif
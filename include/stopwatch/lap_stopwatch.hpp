@@ -0,0 +1,291 @@
+#ifndef _STOPWATCH_LAP_STOPWATCH_HPP_
+#define _STOPWATCH_LAP_STOPWATCH_HPP_
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+namespace sw
+{
+	// behaviour of the lap buffer once its capacity is exhausted
+	enum class lap_buffer_mode
+	{
+		bounded,	// keeps the first laps, further laps are dropped
+		ring		// keeps the most recent laps, the oldest lap is overwritten
+	};
+
+	// statistics over a set of laps, computed on demand by basic_lap_stopwatch::statistics()
+	template <typename duration_type>
+	struct lap_statistics
+	{
+		using duration_t = duration_type;
+
+		std::size_t count = 0;
+		duration_t min = duration_t::zero();
+		duration_t max = duration_t::zero();
+		duration_t mean = duration_t::zero();
+		duration_t stddev = duration_t::zero();
+		duration_t median = duration_t::zero();
+		/// Laps in ascending order.
+		std::vector<duration_t> sorted;
+
+		/**
+			* @brief Returns the given percentile, linearly interpolated between the closest ranks.
+			* @param p	Percentile in [0, 100].
+			* @return	Lap duration at the percentile. Zero if there are no laps.
+		*/
+		duration_t percentile(double p) const;
+		/**
+			* @brief Prints count, min, max, mean, stddev, median, p90 and p99 on a single line.
+			* @param s		Output stream.
+			* @param name	Name printed in front of the statistics.
+		*/
+		template <typename ostrm>
+		void report(ostrm& s, std::string_view name = {}) const;
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		// stopwatch recording the duration of each lap into a buffer preallocated at construction
+		template <typename clock_type, typename report_duration, bool auto_start_on_construction, lap_buffer_mode buffer_mode = lap_buffer_mode::ring>
+		class basic_lap_stopwatch : public basic_stopwatch<clock_type, report_duration, auto_start_on_construction, false>
+		{
+		public:
+			using base_t = basic_stopwatch<clock_type, report_duration, auto_start_on_construction, false>;
+			using typename base_t::clock_t;
+			using typename base_t::clock_duration_t;
+			using typename base_t::clock_time_point_t;
+			using typename base_t::report_duration_t;
+			using statistics_t = lap_statistics<report_duration_t>;
+
+			static constexpr lap_buffer_mode mode = buffer_mode;
+
+			/**
+				* @brief Creates a new basic_lap_stopwatch.
+				* @param capacity	Maximum number of stored laps. Storage is allocated here, recording laps never allocates.
+				* @param name		Name of the stopwatch.
+			*/
+			explicit basic_lap_stopwatch(std::size_t capacity, std::string_view name = {});
+			/**
+				* @brief Clears all laps, resets the elapsed time and starts the stopwatch.
+				* @return Time point of stopwatch start.
+			*/
+			clock_time_point_t start();
+			/**
+				* @brief Records the time since the last start, resume or lap as a new lap. The stopwatch keeps running
+				*		 and the lap is added to the elapsed time.
+				* @return Duration of the lap.
+			*/
+			clock_duration_t lap();
+			/**
+				* @brief Resets the elapsed time accumulator and clears all laps.
+			*/
+			void reset();
+			/**
+				* @brief Returns the number of laps currently stored.
+				* @return Number of stored laps, at most capacity().
+			*/
+			std::size_t lap_count() const noexcept;
+			/**
+				* @brief Returns the number of laps recorded since the last reset, including dropped or overwritten ones.
+				* @return Number of recorded laps.
+			*/
+			std::size_t total_laps() const noexcept { return m_total; }
+			/**
+				* @brief Returns the maximum number of stored laps.
+				* @return Lap buffer capacity.
+			*/
+			std::size_t capacity() const noexcept { return m_laps.size(); }
+			/**
+				* @brief Returns a stored lap in clock duration.
+				* @param i	Index of the lap in recording order, must be less than lap_count().
+				* @return	Duration of the lap.
+			*/
+			clock_duration_t lap_clock(std::size_t i) const;
+			/**
+				* @brief Computes statistics over the stored laps. Allocates and sorts a copy of the laps.
+				* @return Lap statistics in report duration.
+			*/
+			statistics_t statistics() const;
+			/**
+				* @brief Prints the lap statistics.
+			*/
+			template <typename ostrm>
+			void report_laps(ostrm& s) const;
+			/**
+				* @brief Prints the lap statistics to std::cout.
+			*/
+			void report_laps() const;
+
+		private:
+			std::vector<clock_duration_t> m_laps;
+			std::size_t m_next;
+			std::size_t m_total;
+		};
+	}
+
+	using hres_lap_stopwatch_ms = basic_lap_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, false>;
+	using hres_lap_stopwatch_us = basic_lap_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, false>;
+	using hres_lap_stopwatch_ns = basic_lap_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, false>;
+
+	using sys_lap_stopwatch_ms 	= basic_lap_stopwatch<std::chrono::system_clock, sw::milliseconds_d, false>;
+	using sys_lap_stopwatch_us 	= basic_lap_stopwatch<std::chrono::system_clock, sw::microseconds_d, false>;
+	using sys_lap_stopwatch_ns 	= basic_lap_stopwatch<std::chrono::system_clock, sw::nanoseconds_d, false>;
+
+	using cpu_lap_stopwatch_ms 	= basic_lap_stopwatch<cpu_clock, sw::milliseconds_d, false>;
+	using cpu_lap_stopwatch_us 	= basic_lap_stopwatch<cpu_clock, sw::microseconds_d, false>;
+	using cpu_lap_stopwatch_ns 	= basic_lap_stopwatch<cpu_clock, sw::nanoseconds_d, false>;
+
+	using tsc_lap_stopwatch_ms 	= basic_lap_stopwatch<tsc_clock, sw::milliseconds_d, false>;
+	using tsc_lap_stopwatch_us 	= basic_lap_stopwatch<tsc_clock, sw::microseconds_d, false>;
+	using tsc_lap_stopwatch_ns 	= basic_lap_stopwatch<tsc_clock, sw::nanoseconds_d, false>;
+}
+
+// --- implementation ---
+
+template <typename duration_type>
+inline typename sw::lap_statistics<duration_type>::duration_t sw::lap_statistics<duration_type>::percentile(double p) const
+{
+	if (sorted.empty())
+		return duration_t::zero();
+	const double rank = std::clamp(p, 0.0, 100.0) / 100.0 * static_cast<double>(sorted.size() - 1);
+	const std::size_t lower = static_cast<std::size_t>(rank);
+	const std::size_t upper = std::min(lower + 1, sorted.size() - 1);
+	const double fraction = rank - static_cast<double>(lower);
+	const double value = static_cast<double>(sorted[lower].count()) * (1.0 - fraction) + static_cast<double>(sorted[upper].count()) * fraction;
+	return duration_t{static_cast<typename duration_t::rep>(value)};
+}
+
+template <typename duration_type>
+template <typename ostrm>
+inline void sw::lap_statistics<duration_type>::report(ostrm& s, std::string_view name) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const duration_t& d)
+	{
+		const char* const end = sw::format_duration(buffer, d);
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	s << name << "laps " << count;
+	field(", min ", min);
+	field(", max ", max);
+	field(", mean ", mean);
+	field(", stddev ", stddev);
+	field(", median ", median);
+	field(", p90 ", percentile(90.0));
+	field(", p99 ", percentile(99.0));
+	s << std::endl;
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::basic_lap_stopwatch(std::size_t capacity, std::string_view name) :
+	base_t(name),
+	m_laps(std::max<std::size_t>(capacity, 1), clock_duration_t::zero()),
+	m_next(0),
+	m_total(0)
+{
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline typename sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::clock_time_point_t sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::start()
+{
+	m_next = 0;
+	m_total = 0;
+	return base_t::start();
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline typename sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::clock_duration_t sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::lap()
+{
+	const clock_duration_t elapsed_before = base_t::elapsed_clock();
+	base_t::stop();
+	const clock_duration_t lap_duration = base_t::elapsed_clock() - elapsed_before;
+	if constexpr (buffer_mode == lap_buffer_mode::ring)
+	{
+		m_laps[m_next] = lap_duration;
+		if (++m_next == m_laps.size())
+			m_next = 0;
+	}
+	else
+	{
+		if (m_next < m_laps.size())
+			m_laps[m_next++] = lap_duration;
+	}
+	++m_total;
+	return lap_duration;
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline void sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::reset()
+{
+	m_next = 0;
+	m_total = 0;
+	base_t::reset();
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline std::size_t sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::lap_count() const noexcept
+{
+	return std::min(m_total, m_laps.size());
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline typename sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::clock_duration_t sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::lap_clock(std::size_t i) const
+{
+	// in ring mode the oldest stored lap is at the write position once the buffer wrapped around
+	if constexpr (buffer_mode == lap_buffer_mode::ring)
+	{
+		if (m_total > m_laps.size())
+			return m_laps[(m_next + i) % m_laps.size()];
+	}
+	return m_laps[i];
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline typename sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::statistics_t sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::statistics() const
+{
+	statistics_t stats;
+	stats.count = lap_count();
+	if (stats.count == 0)
+		return stats;
+	stats.sorted.reserve(stats.count);
+	double sum = 0.0;
+	for (std::size_t i = 0; i < stats.count; ++i)
+	{
+		const report_duration_t d = as<report_duration_t>(m_laps[i]);
+		sum += static_cast<double>(d.count());
+		stats.sorted.push_back(d);
+	}
+	std::sort(stats.sorted.begin(), stats.sorted.end());
+	const double mean = sum / static_cast<double>(stats.count);
+	double squared_deviations = 0.0;
+	for (const report_duration_t& d : stats.sorted)
+		squared_deviations += (static_cast<double>(d.count()) - mean) * (static_cast<double>(d.count()) - mean);
+	using report_rep = typename report_duration_t::rep;
+	stats.min = stats.sorted.front();
+	stats.max = stats.sorted.back();
+	stats.mean = report_duration_t{static_cast<report_rep>(mean)};
+	stats.stddev = stats.count > 1 ? report_duration_t{static_cast<report_rep>(std::sqrt(squared_deviations / static_cast<double>(stats.count - 1)))} : report_duration_t::zero();
+	stats.median = stats.percentile(50.0);
+	return stats;
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+template<typename ostrm>
+inline void sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::report_laps(ostrm& s) const
+{
+	statistics().report(s, base_t::name());
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, sw::lap_buffer_mode buffer_mode>
+inline void sw::basic_lap_stopwatch<clock_type, report_duration, auto_start_on_construction, buffer_mode>::report_laps() const
+{
+	report_laps(std::cout);
+}
+
+#endif
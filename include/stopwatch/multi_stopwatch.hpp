@@ -0,0 +1,359 @@
+#ifndef _STOPWATCH_MULTI_STOPWATCH_HPP_
+#define _STOPWATCH_MULTI_STOPWATCH_HPP_
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+namespace sw
+{
+	namespace detail
+	{
+		// index of the first occurrence of value_type in types
+		template <typename value_type, typename... types>
+		struct index_of;
+		template <typename value_type, typename... types>
+		struct index_of<value_type, value_type, types...> : std::integral_constant<std::size_t, 0> {};
+		template <typename value_type, typename other_type, typename... types>
+		struct index_of<value_type, other_type, types...> : std::integral_constant<std::size_t, 1 + index_of<value_type, types...>::value> {};
+
+		// cpu_clock measures process cpu time only with the posix clock, otherwise it is a wall clock
+		template <typename clock_type>
+		struct is_process_cpu_clock : std::bool_constant<std::is_same_v<clock_type, cpu_clock> && cpu_clock::cpu_clock_type == CPUClockType::posix_clock> {};
+		template <typename clock_type>
+		struct is_thread_cpu_clock : std::bool_constant<std::is_same_v<clock_type, thread_cpu_clock> && thread_cpu_clock::is_thread_time> {};
+	}
+
+	// metrics derived from the clocks of a basic_multi_stopwatch
+	struct multi_clock_metrics
+	{
+		nanoseconds_d wall{0.0};		// elapsed time of the first clock
+		nanoseconds_d process_cpu{0.0};	// elapsed time of cpu_clock, if it measures process cpu time
+		nanoseconds_d thread_cpu{0.0};	// elapsed time of thread_cpu_clock, if thread cpu time is available
+		bool has_process_cpu = false;
+		bool has_thread_cpu = false;
+
+		/**
+			* @brief Returns the average number of busy cores, process cpu time over wall time. 0 without process cpu time.
+		*/
+		double cores_used() const noexcept;
+		/**
+			* @brief Returns the fraction of all hardware threads kept busy, cores_used() over std::thread::hardware_concurrency().
+		*/
+		double utilization() const noexcept;
+		/**
+			* @brief Returns the time the calling thread was not running, i.e. blocked, sleeping or preempted: wall time
+			*		 minus thread cpu time. 0 without thread cpu time.
+		*/
+		nanoseconds_d off_cpu() const noexcept;
+		/**
+			* @brief Prints wall, process and thread cpu time and the derived metrics on a single line.
+			* @tparam duration_type	Duration type for printing times.
+		*/
+		template <typename ostrm, typename duration_type = sw::milliseconds_d>
+		void report(ostrm& s) const;
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		/*
+			Stopwatch reading several clocks back-to-back on every start, resume and stop, so that e.g. wall and cpu time
+			cover the same region. The first clock should be a wall clock; if the clocks include cpu_clock and
+			thread_cpu_clock, metrics() derives cores used, utilization and off-cpu time. A stopwatch with
+			thread_cpu_clock must be started and stopped on the same thread. report_sink receives the stopwatch on
+			destruction if report_elapsed_at_destruction is true, see sink.hpp.
+		*/
+		template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+		class basic_multi_stopwatch
+		{
+			static_assert(sizeof...(clock_types) > 0, "basic_multi_stopwatch needs at least one clock");
+
+		public:
+			using report_duration_t = report_duration;
+			using report_sink_t = report_sink;
+			using time_points_t = std::tuple<typename clock_types::time_point...>;
+			using durations_t = std::tuple<typename clock_types::duration...>;
+
+			static constexpr std::size_t clock_count = sizeof...(clock_types);
+
+			/**
+				* @brief Creates a new basic_multi_stopwatch with a name.
+				* @param name	Name of the stopwatch.
+			*/
+			explicit basic_multi_stopwatch(std::string_view name = {});
+			/// Destructor. Stops the stopwatch and passes it to the report sink if report_elapsed_at_destruction is true.
+			~basic_multi_stopwatch();
+			/**
+				* @brief Resets the elapsed times and starts the stopwatch.
+				* @return Time points of all clocks.
+			*/
+			time_points_t start();
+			/**
+				* @brief Resumes the stopwatch without resetting the elapsed times.
+				* @return Time points of all clocks.
+			*/
+			time_points_t resume();
+			/**
+				* @brief Stops the stopwatch.
+				* @return Time points of all clocks.
+			*/
+			time_points_t stop();
+			/**
+				* @brief Resets the elapsed time accumulators.
+			*/
+			void reset();
+			/**
+				* @brief Returns the elapsed time of the i-th clock in its own duration.
+			*/
+			template <std::size_t i>
+			std::tuple_element_t<i, durations_t> elapsed_clock() const { return std::get<i>(m_elapsed); }
+			/**
+				* @brief Returns the elapsed time of the first clock of the given type in its own duration.
+			*/
+			template <typename clock_type>
+			typename clock_type::duration elapsed_clock() const { return std::get<detail::index_of<clock_type, clock_types...>::value>(m_elapsed); }
+			/**
+				* @brief Returns the elapsed time of the i-th clock, converted into the given duration type.
+			*/
+			template <std::size_t i, typename duration_type = report_duration_t>
+			duration_type elapsed_as() const { return as<duration_type>(elapsed_clock<i>()); }
+			/**
+				* @brief Returns the elapsed time of the first clock of the given type, converted into the given duration type.
+			*/
+			template <typename clock_type, typename duration_type = report_duration_t>
+			duration_type elapsed_as() const { return as<duration_type>(elapsed_clock<clock_type>()); }
+			/**
+				* @brief Computes the derived metrics from the elapsed times.
+			*/
+			multi_clock_metrics metrics() const;
+			/**
+				* @brief Returns the stopwatches name.
+			*/
+			std::string_view name() const noexcept { return m_name; }
+			/**
+				* @brief Prints the name followed by the metrics.
+				* @tparam duration_type	Duration type for printing times.
+			*/
+			template <typename ostrm, typename duration_type = report_duration_t>
+			void report_elapsed(ostrm& s) const;
+			/**
+				* @brief Prints the name followed by the metrics to std::cout.
+				* @tparam duration_type	Duration type for printing times.
+			*/
+			template <typename duration_type = report_duration_t>
+			void report_elapsed() const;
+			/**
+				* @brief Returns the name, the wall time and the derived metrics as a record for the async sink.
+			*/
+			report_record make_report_record() const noexcept;
+
+		private:
+			template <std::size_t... i>
+			void accumulate(const time_points_t& t1, std::index_sequence<i...>);
+			template <std::size_t i>
+			void collect(multi_clock_metrics& m) const;
+			template <std::size_t... i>
+			void collect_all(multi_clock_metrics& m, std::index_sequence<i...>) const;
+
+			std::string_view m_name;
+			time_points_t m_t0;
+			durations_t m_elapsed;
+		};
+	}
+
+	using hres_multi_stopwatch_ms 			= basic_multi_stopwatch<sw::milliseconds_d, false, false, sw::async_sink, std::chrono::high_resolution_clock, cpu_clock, thread_cpu_clock>;
+	using hres_scoped_multi_stopwatch_ms 	= basic_multi_stopwatch<sw::milliseconds_d, true, true, sw::async_sink, std::chrono::high_resolution_clock, cpu_clock, thread_cpu_clock>;
+	using hres_multi_stopwatch_us 			= basic_multi_stopwatch<sw::microseconds_d, false, false, sw::async_sink, std::chrono::high_resolution_clock, cpu_clock, thread_cpu_clock>;
+	using hres_scoped_multi_stopwatch_us 	= basic_multi_stopwatch<sw::microseconds_d, true, true, sw::async_sink, std::chrono::high_resolution_clock, cpu_clock, thread_cpu_clock>;
+}
+
+// --- implementation ---
+
+inline double sw::multi_clock_metrics::cores_used() const noexcept
+{
+	return has_process_cpu && wall.count() > 0.0 ? process_cpu / wall : 0.0;
+}
+
+inline double sw::multi_clock_metrics::utilization() const noexcept
+{
+	return cores_used() / static_cast<double>(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+inline sw::nanoseconds_d sw::multi_clock_metrics::off_cpu() const noexcept
+{
+	return has_thread_cpu ? std::max(wall - thread_cpu, nanoseconds_d::zero()) : nanoseconds_d::zero();
+}
+
+template <typename ostrm, typename duration_type>
+inline void sw::multi_clock_metrics::report(ostrm& s) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const nanoseconds_d& d)
+	{
+		const char* const end = sw::format_duration(buffer, as<duration_type>(d));
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	field("wall ", wall);
+	if (has_process_cpu)
+	{
+		field(", process cpu ", process_cpu);
+		s << ", cores used " << cores_used() << ", utilization " << 100.0 * utilization() << " %";
+	}
+	if (has_thread_cpu)
+	{
+		field(", thread cpu ", thread_cpu);
+		field(", off-cpu ", off_cpu());
+	}
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::basic_multi_stopwatch(std::string_view name) :
+	m_name(name),
+	m_t0(),
+	m_elapsed(clock_types::duration::zero()...)
+{
+	if constexpr (auto_start_on_construction && stopwatch_enabled)
+		m_t0 = time_points_t{clock_types::now()...};
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::~basic_multi_stopwatch()
+{
+	if constexpr (report_elapsed_at_destruction && stopwatch_enabled)
+	{
+		stop();
+		report_sink::submit(*this);
+	}
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline typename sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::time_points_t sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::start()
+{
+	reset();
+	return resume();
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline typename sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::time_points_t sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::resume()
+{
+	// braced initializers are evaluated in order, so the clocks are read back-to-back in the order of clock_types
+	if constexpr (stopwatch_enabled)
+		m_t0 = time_points_t{clock_types::now()...};
+	return m_t0;
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline typename sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::time_points_t sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::stop()
+{
+	if constexpr (stopwatch_enabled)
+	{
+		const time_points_t t1{clock_types::now()...};
+		accumulate(t1, std::index_sequence_for<clock_types...>{});
+		m_t0 = t1;
+	}
+	return m_t0;
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline void sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::reset()
+{
+	m_elapsed = durations_t{clock_types::duration::zero()...};
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline sw::multi_clock_metrics sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::metrics() const
+{
+	multi_clock_metrics m;
+	collect_all(m, std::index_sequence_for<clock_types...>{});
+	return m;
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+template <typename ostrm, typename duration_type>
+inline void sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::report_elapsed(ostrm& s) const
+{
+	if constexpr (stopwatch_enabled)
+	{
+		s << m_name;
+		metrics().template report<ostrm, duration_type>(s);
+		s << std::endl;
+	}
+	else
+		static_cast<void>(s);
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+template <typename duration_type>
+inline void sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::report_elapsed() const
+{
+	report_elapsed<std::ostream, duration_type>(std::cout);
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+inline sw::report_record sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::make_report_record() const noexcept
+{
+	const multi_clock_metrics m = metrics();
+	report_record r = report_record::make(m_name, as<report_duration_t>(m.wall));
+	if (m.has_process_cpu)
+	{
+		r.add_duration("process cpu", as<report_duration_t>(m.process_cpu));
+		r.add_count("cores used", m.cores_used());
+		r.add_count("utilization", 100.0 * m.utilization(), "%");
+	}
+	if (m.has_thread_cpu)
+	{
+		r.add_duration("thread cpu", as<report_duration_t>(m.thread_cpu));
+		r.add_duration("off-cpu", as<report_duration_t>(m.off_cpu()));
+	}
+	return r;
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+template <std::size_t... i>
+inline void sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::accumulate(const time_points_t& t1, std::index_sequence<i...>)
+{
+	((std::get<i>(m_elapsed) += std::get<i>(t1) - std::get<i>(m_t0)), ...);
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+template <std::size_t i>
+inline void sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::collect(multi_clock_metrics& m) const
+{
+	using clock_i_t = std::tuple_element_t<i, std::tuple<clock_types...>>;
+	const nanoseconds_d d = as<nanoseconds_d>(std::get<i>(m_elapsed));
+	if constexpr (i == 0)
+		m.wall = d;
+	else if constexpr (detail::is_process_cpu_clock<clock_i_t>::value)
+	{
+		if (!m.has_process_cpu)
+		{
+			m.process_cpu = d;
+			m.has_process_cpu = true;
+		}
+	}
+	else if constexpr (detail::is_thread_cpu_clock<clock_i_t>::value)
+	{
+		if (!m.has_thread_cpu)
+		{
+			m.thread_cpu = d;
+			m.has_thread_cpu = true;
+		}
+	}
+}
+
+template <typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink, typename... clock_types>
+template <std::size_t... i>
+inline void sw::basic_multi_stopwatch<report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink, clock_types...>::collect_all(multi_clock_metrics& m, std::index_sequence<i...>) const
+{
+	(collect<i>(m), ...);
+}
+
+#endif
@@ -0,0 +1,508 @@
+#ifndef _STOPWATCH_PERF_STOPWATCH_HPP_
+#define _STOPWATCH_PERF_STOPWATCH_HPP_
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+// hardware performance counters through perf_event_open are available on linux
+#if !defined(STOPWATCH_HAS_PERF_EVENTS)
+	#if defined(__linux__) && __has_include(<linux/perf_event.h>) && __has_include(<sys/syscall.h>) && __has_include(<sys/mman.h>)
+		#include <linux/perf_event.h>
+		#include <sys/mman.h>
+		#include <sys/syscall.h>
+		#include <unistd.h>
+		#define STOPWATCH_HAS_PERF_EVENTS 1
+	#else
+		#define STOPWATCH_HAS_PERF_EVENTS 0
+	#endif
+#endif
+// counters are read in user space with rdpmc where the kernel allows it
+#if STOPWATCH_HAS_PERF_EVENTS && STOPWATCH_HAS_TSC && defined(__GNUC__)
+	#define STOPWATCH_HAS_RDPMC 1
+#else
+	#define STOPWATCH_HAS_RDPMC 0
+#endif
+
+namespace sw
+{
+	// hardware events counted by perf stopwatches
+	enum class perf_event
+	{
+		cycles = 0,
+		instructions = 1,
+		cache_misses = 2,
+		branch_misses = 3
+	};
+
+	inline constexpr std::size_t perf_event_count = 4;
+
+	// values of the perf events; events that could not be opened are not valid and read as zero
+	struct perf_counters
+	{
+		std::uint64_t values[perf_event_count] = {};
+		std::uint32_t valid = 0;	// bit i is set if perf_event i was counted
+
+		std::uint64_t operator[](perf_event e) const noexcept { return values[static_cast<std::size_t>(e)]; }
+		/**
+			* @brief Returns whether an event was counted.
+		*/
+		bool has(perf_event e) const noexcept { return (valid >> static_cast<std::uint32_t>(e)) & 1u; }
+		/**
+			* @brief Returns instructions per cycle, 0 if either event was not counted.
+		*/
+		double instructions_per_cycle() const noexcept;
+		perf_counters& operator+=(const perf_counters& other) noexcept;
+		/// Per event difference, valid where both operands are valid.
+		friend perf_counters operator-(const perf_counters& a, const perf_counters& b) noexcept
+		{
+			perf_counters d;
+			d.valid = a.valid & b.valid;
+			for (std::size_t i = 0; i < perf_event_count; ++i)
+				d.values[i] = (d.valid >> i) & 1u ? a.values[i] - b.values[i] : 0;
+			return d;
+		}
+		/**
+			* @brief Prints the valid counters and the ipc, or that no counters are available.
+		*/
+		template <typename ostrm>
+		void report(ostrm& s) const;
+	};
+
+	/*
+		perf_event_open group counting cycles, instructions, cache misses and branch misses of the calling thread
+		in user space. Each counter page is mapped, so that counters are read with rdpmc without a system call
+		while the group is scheduled on the pmu; otherwise the whole group is read with one read() call.
+		Events that cannot be opened, e.g. due to perf_event_paranoid, a missing pmu in a container or vm, or a
+		non-linux platform, are left out, and with no events the group is unavailable and reads nothing.
+		Counts are not scaled for multiplexing.
+	*/
+	class perf_event_group
+	{
+	public:
+		/**
+			* @brief Returns the calling thread's group, opened on first use.
+		*/
+		static perf_event_group& thread_group();
+
+		perf_event_group();
+		perf_event_group(const perf_event_group&) = delete;
+		perf_event_group& operator=(const perf_event_group&) = delete;
+		~perf_event_group();
+		/**
+			* @brief Returns whether at least one event is counted.
+		*/
+		bool available() const noexcept { return m_valid != 0; }
+		/**
+			* @brief Returns the bit mask of counted events, bit i stands for perf_event i.
+		*/
+		std::uint32_t valid() const noexcept { return m_valid; }
+		/**
+			* @brief Returns whether all counter pages allow reading with rdpmc.
+		*/
+		bool uses_rdpmc() const noexcept { return m_rdpmc; }
+		/**
+			* @brief Returns the errno of the first event that failed to open, 0 if all events were opened.
+		*/
+		int error() const noexcept { return m_error; }
+		/**
+			* @brief Reads the current counter values. Must be called by the thread that opened the group.
+		*/
+		perf_counters read() const noexcept;
+
+	private:
+		// reads all counters through their mapped pages, fails if a counter is not currently on the pmu
+		bool read_rdpmc(perf_counters& c) const noexcept;
+		void read_group(perf_counters& c) const noexcept;
+
+		int m_fd[perf_event_count];
+		void* m_page[perf_event_count];
+		std::size_t m_order[perf_event_count];	// events in the order they joined the group, as returned by read()
+		std::size_t m_opened;
+		std::uint32_t m_valid;
+		int m_error;
+		bool m_rdpmc;
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		// stopwatch that also accumulates the perf event counts of the calling thread between start or resume and stop
+		// a stopwatch must be started and stopped on the thread that created it
+		// report_sink receives the stopwatch on destruction if report_elapsed_at_destruction is true, see sink.hpp
+		template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink = sw::async_sink>
+		class basic_perf_stopwatch : public basic_stopwatch<clock_type, report_duration, auto_start_on_construction, false>
+		{
+		public:
+			using base_t = basic_stopwatch<clock_type, report_duration, auto_start_on_construction, false>;
+			using typename base_t::clock_t;
+			using typename base_t::clock_duration_t;
+			using typename base_t::clock_time_point_t;
+			using typename base_t::report_duration_t;
+			using report_sink_t = report_sink;
+
+			/**
+				* @brief Creates a new basic_perf_stopwatch, opening the thread's perf event group on first use.
+				* @param name	Name of the stopwatch.
+			*/
+			explicit basic_perf_stopwatch(std::string_view name = {});
+			basic_perf_stopwatch(const basic_perf_stopwatch&) = default;
+			basic_perf_stopwatch& operator=(const basic_perf_stopwatch&) = default;
+			/// Destructor. Stops the stopwatch and passes it to the report sink if report_elapsed_at_destruction is true.
+			~basic_perf_stopwatch();
+			/**
+				* @brief Resets elapsed time and counters and starts the stopwatch.
+				* @return Time point of stopwatch start.
+			*/
+			clock_time_point_t start();
+			/**
+				* @brief Resumes the stopwatch without resetting elapsed time and counters.
+				* @return Time point of stopwatch start.
+			*/
+			clock_time_point_t resume();
+			/**
+				* @brief Stops the stopwatch and adds the counts since the last start or resume. Does nothing if not running.
+				* @return Time point of stopwatch stop.
+			*/
+			clock_time_point_t stop();
+			/**
+				* @brief Resets elapsed time and counters.
+			*/
+			void reset();
+			/**
+				* @brief Returns the counts accumulated up to the last stop.
+			*/
+			const perf_counters& counters() const noexcept { return m_counters; }
+			/**
+				* @brief Returns whether any perf event is counted, otherwise the stopwatch measures time only.
+			*/
+			bool counters_available() const noexcept { return m_group != nullptr && m_group->available(); }
+			/**
+				* @brief Prints name, elapsed time and counters.
+				* @tparam duration_type	Duration type for printing the elapsed time.
+			*/
+			template <typename ostrm, typename duration_type = report_duration_t>
+			void report_elapsed(ostrm& s) const;
+			/**
+				* @brief Prints name, elapsed time and counters to std::cout.
+				* @tparam duration_type	Duration type for printing the elapsed time.
+			*/
+			template <typename duration_type = report_duration_t>
+			void report_elapsed() const;
+			/**
+				* @brief Returns name, elapsed time and the valid counters as a record for the async sink.
+			*/
+			report_record make_report_record() const noexcept;
+
+		private:
+			const perf_event_group* m_group;
+			perf_counters m_c0;
+			perf_counters m_counters;
+			bool m_running;
+		};
+	}
+
+	using hres_perf_stopwatch_us 		= basic_perf_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, false, false>;
+	using hres_scoped_perf_stopwatch_us = basic_perf_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, true, true>;
+	using hres_perf_stopwatch_ns 		= basic_perf_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, false, false>;
+	using hres_scoped_perf_stopwatch_ns = basic_perf_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, true, true>;
+
+	using sys_perf_stopwatch_us 		= basic_perf_stopwatch<std::chrono::system_clock, sw::microseconds_d, false, false>;
+	using sys_scoped_perf_stopwatch_us 	= basic_perf_stopwatch<std::chrono::system_clock, sw::microseconds_d, true, true>;
+	using sys_perf_stopwatch_ns 		= basic_perf_stopwatch<std::chrono::system_clock, sw::nanoseconds_d, false, false>;
+	using sys_scoped_perf_stopwatch_ns 	= basic_perf_stopwatch<std::chrono::system_clock, sw::nanoseconds_d, true, true>;
+
+	using cpu_perf_stopwatch_us 		= basic_perf_stopwatch<cpu_clock, sw::microseconds_d, false, false>;
+	using cpu_scoped_perf_stopwatch_us 	= basic_perf_stopwatch<cpu_clock, sw::microseconds_d, true, true>;
+	using cpu_perf_stopwatch_ns 		= basic_perf_stopwatch<cpu_clock, sw::nanoseconds_d, false, false>;
+	using cpu_scoped_perf_stopwatch_ns 	= basic_perf_stopwatch<cpu_clock, sw::nanoseconds_d, true, true>;
+
+	using tsc_perf_stopwatch_us 		= basic_perf_stopwatch<tsc_clock, sw::microseconds_d, false, false>;
+	using tsc_scoped_perf_stopwatch_us 	= basic_perf_stopwatch<tsc_clock, sw::microseconds_d, true, true>;
+	using tsc_perf_stopwatch_ns 		= basic_perf_stopwatch<tsc_clock, sw::nanoseconds_d, false, false>;
+	using tsc_scoped_perf_stopwatch_ns 	= basic_perf_stopwatch<tsc_clock, sw::nanoseconds_d, true, true>;
+}
+
+// --- implementation ---
+
+inline double sw::perf_counters::instructions_per_cycle() const noexcept
+{
+	if (!has(perf_event::cycles) || !has(perf_event::instructions) || (*this)[perf_event::cycles] == 0)
+		return 0.0;
+	return static_cast<double>((*this)[perf_event::instructions]) / static_cast<double>((*this)[perf_event::cycles]);
+}
+
+inline sw::perf_counters& sw::perf_counters::operator+=(const perf_counters& other) noexcept
+{
+	valid &= other.valid;
+	for (std::size_t i = 0; i < perf_event_count; ++i)
+		values[i] = (valid >> i) & 1u ? values[i] + other.values[i] : 0;
+	return *this;
+}
+
+template <typename ostrm>
+inline void sw::perf_counters::report(ostrm& s) const
+{
+	static constexpr const char* names[perf_event_count] = {"cycles ", "instructions ", "cache misses ", "branch misses "};
+	if (valid == 0)
+	{
+		s << "counters unavailable";
+		return;
+	}
+	bool first = true;
+	for (std::size_t i = 0; i < perf_event_count; ++i)
+	{
+		if ((valid >> i) & 1u)
+		{
+			s << (first ? "" : ", ") << names[i] << values[i];
+			first = false;
+		}
+	}
+	if (has(perf_event::cycles) && has(perf_event::instructions))
+		s << ", ipc " << instructions_per_cycle();
+}
+
+inline sw::perf_event_group& sw::perf_event_group::thread_group()
+{
+	thread_local perf_event_group group;
+	return group;
+}
+
+inline sw::perf_event_group::perf_event_group() :
+	m_fd{-1, -1, -1, -1},
+	m_page{nullptr, nullptr, nullptr, nullptr},
+	m_order{0, 0, 0, 0},
+	m_opened(0),
+	m_valid(0),
+	m_error(0),
+	m_rdpmc(false)
+{
+#if STOPWATCH_HAS_PERF_EVENTS
+	static constexpr std::uint64_t configs[perf_event_count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+	const long page_size = sysconf(_SC_PAGESIZE);
+	bool rdpmc = STOPWATCH_HAS_RDPMC != 0;
+	for (std::size_t i = 0; i < perf_event_count; ++i)
+	{
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.read_format = PERF_FORMAT_GROUP;
+		// counting user space only is permitted up to perf_event_paranoid 2
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		const int leader = m_opened == 0 ? -1 : m_fd[m_order[0]];
+		const int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+		if (fd < 0)
+		{
+			if (m_error == 0)
+				m_error = errno;
+			continue;
+		}
+		m_fd[i] = fd;
+		m_order[m_opened++] = i;
+		m_valid |= 1u << i;
+		void* const page = mmap(nullptr, static_cast<std::size_t>(page_size), PROT_READ, MAP_SHARED, fd, 0);
+		if (page == MAP_FAILED)
+			rdpmc = false;
+		else
+		{
+			m_page[i] = page;
+			rdpmc = rdpmc && static_cast<const perf_event_mmap_page*>(page)->cap_user_rdpmc;
+		}
+	}
+	m_rdpmc = rdpmc && m_opened != 0;
+#else
+	m_error = ENOSYS;
+#endif
+}
+
+inline sw::perf_event_group::~perf_event_group()
+{
+#if STOPWATCH_HAS_PERF_EVENTS
+	const long page_size = sysconf(_SC_PAGESIZE);
+	for (std::size_t i = 0; i < perf_event_count; ++i)
+	{
+		if (m_page[i] != nullptr)
+			munmap(m_page[i], static_cast<std::size_t>(page_size));
+	}
+	// close members before the leader
+	for (std::size_t i = m_opened; i-- > 0;)
+		close(m_fd[m_order[i]]);
+#endif
+}
+
+inline sw::perf_counters sw::perf_event_group::read() const noexcept
+{
+	perf_counters c;
+	if (m_valid == 0)
+		return c;
+	if (!m_rdpmc || !read_rdpmc(c))
+		read_group(c);
+	return c;
+}
+
+inline bool sw::perf_event_group::read_rdpmc(perf_counters& c) const noexcept
+{
+#if STOPWATCH_HAS_RDPMC
+	for (std::size_t k = 0; k < m_opened; ++k)
+	{
+		const std::size_t i = m_order[k];
+		const volatile perf_event_mmap_page* const page = static_cast<const volatile perf_event_mmap_page*>(m_page[i]);
+		// seqlock protocol of the perf mmap page
+		std::uint32_t sequence;
+		std::uint64_t count;
+		do
+		{
+			sequence = page->lock;
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+			const std::uint32_t index = page->index;
+			if (index == 0)
+				return false;
+			std::int64_t pmc = static_cast<std::int64_t>(__rdpmc(static_cast<int>(index - 1)));
+			const unsigned shift = 64u - page->pmc_width;
+			pmc = static_cast<std::int64_t>(static_cast<std::uint64_t>(pmc) << shift) >> shift;
+			count = static_cast<std::uint64_t>(page->offset + pmc);
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+		} while (page->lock != sequence);
+		c.values[i] = count;
+	}
+	c.valid = m_valid;
+	return true;
+#else
+	static_cast<void>(c);
+	return false;
+#endif
+}
+
+inline void sw::perf_event_group::read_group(perf_counters& c) const noexcept
+{
+#if STOPWATCH_HAS_PERF_EVENTS
+	// PERF_FORMAT_GROUP layout: number of events, then one value per event in group order
+	std::uint64_t buffer[1 + perf_event_count];
+	const ssize_t size = ::read(m_fd[m_order[0]], buffer, sizeof(buffer));
+	if (size < static_cast<ssize_t>(sizeof(std::uint64_t)) || buffer[0] != m_opened)
+		return;
+	for (std::size_t k = 0; k < m_opened; ++k)
+		c.values[m_order[k]] = buffer[1 + k];
+	c.valid = m_valid;
+#else
+	static_cast<void>(c);
+#endif
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::basic_perf_stopwatch(std::string_view name) :
+	base_t(name),
+	m_group(stopwatch_enabled ? &perf_event_group::thread_group() : nullptr),
+	m_c0(),
+	m_counters(),
+	m_running(auto_start_on_construction)
+{
+	if constexpr (stopwatch_enabled)
+	{
+		m_counters.valid = m_group->valid();
+		if constexpr (auto_start_on_construction)
+			m_c0 = m_group->read();
+	}
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::~basic_perf_stopwatch()
+{
+	if constexpr (report_elapsed_at_destruction && stopwatch_enabled)
+	{
+		stop();
+		report_sink::submit(*this);
+	}
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::start()
+{
+	reset();
+	return resume();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::resume()
+{
+	// counters are read closest to the measured section
+	m_running = true;
+	const clock_time_point_t t0 = base_t::resume();
+	if constexpr (stopwatch_enabled)
+		m_c0 = m_group->read();
+	return t0;
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::stop()
+{
+	// without a start m_c0 holds no counts, and its empty valid mask would stick to the counters
+	if (!m_running)
+		return base_t::last_time_point();
+	m_running = false;
+	if constexpr (stopwatch_enabled)
+	{
+		const perf_counters c1 = m_group->read();
+		m_counters += c1 - m_c0;
+		m_c0 = c1;
+	}
+	return base_t::stop();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline void sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::reset()
+{
+	base_t::reset();
+	m_counters = perf_counters{};
+	if constexpr (stopwatch_enabled)
+		m_counters.valid = m_group->valid();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+template <typename ostrm, typename duration_type>
+inline void sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_elapsed(ostrm& s) const
+{
+	if constexpr (stopwatch_enabled)
+	{
+		char buffer[sw::max_duration_str_length];
+		const char* const end = sw::format_duration(buffer, base_t::template elapsed_as<duration_type>());
+		s << base_t::name() << std::string_view(buffer, static_cast<std::size_t>(end - buffer)) << ", ";
+		m_counters.report(s);
+		s << std::endl;
+	}
+	else
+		static_cast<void>(s);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+template <typename duration_type>
+inline void sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_elapsed() const
+{
+	report_elapsed<std::ostream, duration_type>(std::cout);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::report_record sw::basic_perf_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::make_report_record() const noexcept
+{
+	static constexpr const char* labels[perf_event_count] = {"cycles", "instructions", "cache misses", "branch misses"};
+	report_record r = report_record::make(base_t::name(), base_t::elapsed());
+	for (std::size_t i = 0; i < perf_event_count; ++i)
+	{
+		if ((m_counters.valid >> i) & 1u)
+			r.add_count(labels[i], m_counters.values[i]);
+	}
+	if (m_counters.has(perf_event::cycles) && m_counters.has(perf_event::instructions))
+		r.add_count("ipc", m_counters.instructions_per_cycle());
+	return r;
+}
+
+#endif
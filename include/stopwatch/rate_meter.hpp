@@ -0,0 +1,321 @@
+#ifndef _STOPWATCH_RATE_METER_HPP_
+#define _STOPWATCH_RATE_METER_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+
+// number of cache line padded counter shards of a rate meter; threads are spread over the shards round-robin
+#if !defined(STOPWATCH_RATE_METER_SHARDS)
+	#define STOPWATCH_RATE_METER_SHARDS 16
+#endif
+// maximum number of snapshots remembered for the sliding window rates
+#if !defined(STOPWATCH_RATE_METER_WINDOW_SAMPLES)
+	#define STOPWATCH_RATE_METER_WINDOW_SAMPLES 64
+#endif
+
+namespace sw
+{
+	// totals and rates of a rate meter at one point in time, rates are per second
+	struct rate_snapshot
+	{
+		static constexpr std::size_t ewma_count = 3;
+		/// Time constants of the exponentially weighted moving averages in seconds.
+		static constexpr double ewma_seconds[ewma_count] = {1.0, 5.0, 15.0};
+
+		std::uint64_t items = 0;					// items recorded since construction or reset
+		std::uint64_t bytes = 0;					// bytes recorded since construction or reset
+		nanoseconds_d elapsed{0.0};					// time since construction or reset
+		nanoseconds_d window{0.0};					// time covered by the window rates
+		double items_per_second = 0.0;				// mean over elapsed
+		double bytes_per_second = 0.0;
+		double window_items_per_second = 0.0;		// mean over window
+		double window_bytes_per_second = 0.0;
+		double ewma_items_per_second[ewma_count] = {};
+		double ewma_bytes_per_second[ewma_count] = {};
+
+		/**
+			* @brief Converts a rate per second into a rate per duration_type, e.g. per millisecond.
+		*/
+		template <typename duration_type>
+		static double per(double per_second) noexcept { return per_second * as<seconds_d>(duration_type{1}).count(); }
+		/**
+			* @brief Prints totals, mean, window and ewma rates of items, and of bytes if any were recorded.
+			* @tparam duration_type	Time unit of the printed rates.
+			* @param s		Output stream.
+			* @param name	Name printed in front of every line.
+		*/
+		template <typename ostrm, typename duration_type = sw::seconds_d>
+		void report(ostrm& s, std::string_view name = {}) const;
+	};
+
+	namespace detail
+	{
+		// shard of the calling thread, assigned round-robin on first use and shared by all rate meters
+		inline std::size_t rate_meter_shard() noexcept
+		{
+			static std::atomic<std::size_t> next{0};
+			thread_local const std::size_t shard = next.fetch_add(1, std::memory_order_relaxed) % STOPWATCH_RATE_METER_SHARDS;
+			return shard;
+		}
+	}
+
+	/*
+		Throughput meter. Producer threads add item and byte counts to one of several cache line padded shards with
+		a relaxed fetch_add and never read a clock; threads only contend with the few threads sharing their shard.
+		snapshot() sums the shards, reads the clock and updates the window and ewma rates under a mutex, so it
+		should be called periodically, e.g. once per second, for the window and ewma rates to be meaningful.
+	*/
+	template <typename clock_type>
+	class basic_rate_meter
+	{
+	public:
+		using clock_t = clock_type;
+		using clock_time_point_t = typename clock_t::time_point;
+
+		static constexpr std::size_t shard_count = STOPWATCH_RATE_METER_SHARDS;
+		static constexpr std::size_t window_samples = STOPWATCH_RATE_METER_WINDOW_SAMPLES;
+
+		/**
+			* @brief Creates a new basic_rate_meter.
+			* @param window	Length of the sliding window of the window rates.
+		*/
+		explicit basic_rate_meter(std::chrono::nanoseconds window = std::chrono::seconds(1));
+		basic_rate_meter(const basic_rate_meter&) = delete;
+		basic_rate_meter& operator=(const basic_rate_meter&) = delete;
+		/**
+			* @brief Adds items and bytes. Lock-free and safe to call from any thread.
+			* @param items	Number of items, e.g. requests.
+			* @param bytes	Number of bytes.
+		*/
+		void record(std::uint64_t items = 1, std::uint64_t bytes = 0) noexcept;
+		/**
+			* @brief Returns the items recorded since construction or reset, without updating the rates.
+		*/
+		std::uint64_t total_items() const noexcept;
+		/**
+			* @brief Returns the bytes recorded since construction or reset, without updating the rates.
+		*/
+		std::uint64_t total_bytes() const noexcept;
+		/**
+			* @brief Updates the window and ewma rates and returns totals and rates.
+		*/
+		rate_snapshot snapshot();
+		/**
+			* @brief Restarts totals and rates. Items recorded concurrently may be counted before or after the reset.
+		*/
+		void reset();
+
+	private:
+		struct alignas(64) shard
+		{
+			std::atomic<std::uint64_t> items{0};
+			std::atomic<std::uint64_t> bytes{0};
+		};
+		struct sample
+		{
+			clock_time_point_t time;
+			std::uint64_t items;
+			std::uint64_t bytes;
+		};
+
+		sample read_counters() const noexcept;
+		// restarts the rates at s, the mutex must be held
+		void restart(const sample& s) noexcept;
+
+		shard m_shards[shard_count];
+		std::mutex m_mutex;
+		std::chrono::nanoseconds m_window_length;
+		sample m_base;		// counters at construction or reset
+		// copies of m_base's counters for the lock-free totals
+		std::atomic<std::uint64_t> m_base_items;
+		std::atomic<std::uint64_t> m_base_bytes;
+		sample m_last;		// counters at the last snapshot
+		sample m_window[window_samples];	// ring of previous snapshots
+		std::size_t m_window_first;
+		std::size_t m_window_size;
+		bool m_ewma_valid;
+		double m_ewma_items[rate_snapshot::ewma_count];
+		double m_ewma_bytes[rate_snapshot::ewma_count];
+	};
+
+	using rate_meter 		= basic_rate_meter<std::chrono::steady_clock>;
+	using hres_rate_meter 	= basic_rate_meter<std::chrono::high_resolution_clock>;
+	using tsc_rate_meter 	= basic_rate_meter<tsc_clock>;
+}
+
+// --- implementation ---
+
+template <typename ostrm, typename duration_type>
+inline void sw::rate_snapshot::report(ostrm& s, std::string_view name) const
+{
+	const char* const unit = sw::time_unit_postfix<duration_type>::str();
+	char buffer[sw::max_duration_str_length];
+	const auto number = [&](double value) { return std::string_view(buffer, static_cast<std::size_t>(sw::format_count(buffer, value) - buffer)); };
+	const auto line = [&](const char* label, std::uint64_t total, double mean, double windowed, const double* ewma)
+	{
+		s << name << label << ' ' << total << ", mean " << number(per<duration_type>(mean)) << " /" << unit;
+		const char* const end = sw::format_duration(buffer, as<duration_type>(window));
+		s << ", window " << std::string_view(buffer, static_cast<std::size_t>(end - buffer)) << ": " << number(per<duration_type>(windowed)) << " /" << unit;
+		for (std::size_t i = 0; i < ewma_count; ++i)
+			s << ", ewma " << ewma_seconds[i] << " s: " << number(per<duration_type>(ewma[i])) << " /" << unit;
+		s << '\n';
+	};
+	line("items", items, items_per_second, window_items_per_second, ewma_items_per_second);
+	if (bytes != 0)
+		line("bytes", bytes, bytes_per_second, window_bytes_per_second, ewma_bytes_per_second);
+	s.flush();
+}
+
+template <typename clock_type>
+inline sw::basic_rate_meter<clock_type>::basic_rate_meter(std::chrono::nanoseconds window) :
+	m_shards(),
+	m_mutex(),
+	m_window_length(window),
+	m_base(),
+	m_base_items(0),
+	m_base_bytes(0),
+	m_last(),
+	m_window(),
+	m_window_first(0),
+	m_window_size(0),
+	m_ewma_valid(false),
+	m_ewma_items(),
+	m_ewma_bytes()
+{
+	restart(read_counters());
+}
+
+template <typename clock_type>
+inline void sw::basic_rate_meter<clock_type>::record(std::uint64_t items, std::uint64_t bytes) noexcept
+{
+	shard& s = m_shards[detail::rate_meter_shard()];
+	s.items.fetch_add(items, std::memory_order_relaxed);
+	if (bytes != 0)
+		s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+template <typename clock_type>
+inline std::uint64_t sw::basic_rate_meter<clock_type>::total_items() const noexcept
+{
+	// the base first: acquiring it makes the shards read below at least as large as when reset() read them
+	const std::uint64_t base = m_base_items.load(std::memory_order_acquire);
+	std::uint64_t items = 0;
+	for (const shard& s : m_shards)
+		items += s.items.load(std::memory_order_relaxed);
+	return items - base;
+}
+
+template <typename clock_type>
+inline std::uint64_t sw::basic_rate_meter<clock_type>::total_bytes() const noexcept
+{
+	// the base first, see total_items()
+	const std::uint64_t base = m_base_bytes.load(std::memory_order_acquire);
+	std::uint64_t bytes = 0;
+	for (const shard& s : m_shards)
+		bytes += s.bytes.load(std::memory_order_relaxed);
+	return bytes - base;
+}
+
+template <typename clock_type>
+inline sw::rate_snapshot sw::basic_rate_meter<clock_type>::snapshot()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const sample now = read_counters();
+	const auto seconds_between = [](const sample& a, const sample& b) { return as<seconds_d>(b.time - a.time).count(); };
+
+	rate_snapshot r;
+	r.items = now.items - m_base.items;
+	r.bytes = now.bytes - m_base.bytes;
+	r.elapsed = as<nanoseconds_d>(now.time - m_base.time);
+	const double elapsed_seconds = seconds_between(m_base, now);
+	if (elapsed_seconds > 0.0)
+	{
+		r.items_per_second = static_cast<double>(r.items) / elapsed_seconds;
+		r.bytes_per_second = static_cast<double>(r.bytes) / elapsed_seconds;
+	}
+
+	// ewma rates, decayed by the time since the last snapshot
+	const double dt = seconds_between(m_last, now);
+	if (dt > 0.0)
+	{
+		const double items_rate = static_cast<double>(now.items - m_last.items) / dt;
+		const double bytes_rate = static_cast<double>(now.bytes - m_last.bytes) / dt;
+		for (std::size_t i = 0; i < rate_snapshot::ewma_count; ++i)
+		{
+			const double alpha = m_ewma_valid ? 1.0 - std::exp(-dt / rate_snapshot::ewma_seconds[i]) : 1.0;
+			m_ewma_items[i] += alpha * (items_rate - m_ewma_items[i]);
+			m_ewma_bytes[i] += alpha * (bytes_rate - m_ewma_bytes[i]);
+		}
+		m_ewma_valid = true;
+		m_last = now;
+	}
+	std::copy(m_ewma_items, m_ewma_items + rate_snapshot::ewma_count, r.ewma_items_per_second);
+	std::copy(m_ewma_bytes, m_ewma_bytes + rate_snapshot::ewma_count, r.ewma_bytes_per_second);
+
+	// window rates against the newest snapshot at least one window old, or the oldest one remembered
+	while (m_window_size > 1 && now.time - m_window[(m_window_first + 1) % window_samples].time >= m_window_length)
+	{
+		m_window_first = (m_window_first + 1) % window_samples;
+		--m_window_size;
+	}
+	const sample& first = m_window[m_window_first];
+	const double window_seconds = seconds_between(first, now);
+	if (window_seconds > 0.0)
+	{
+		r.window = as<nanoseconds_d>(now.time - first.time);
+		r.window_items_per_second = static_cast<double>(now.items - first.items) / window_seconds;
+		r.window_bytes_per_second = static_cast<double>(now.bytes - first.bytes) / window_seconds;
+	}
+	if (m_window_size == window_samples)
+	{
+		m_window_first = (m_window_first + 1) % window_samples;
+		--m_window_size;
+	}
+	m_window[(m_window_first + m_window_size++) % window_samples] = now;
+	return r;
+}
+
+template <typename clock_type>
+inline void sw::basic_rate_meter<clock_type>::reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	restart(read_counters());
+}
+
+template <typename clock_type>
+inline typename sw::basic_rate_meter<clock_type>::sample sw::basic_rate_meter<clock_type>::read_counters() const noexcept
+{
+	sample s{clock_t::now(), 0, 0};
+	for (const shard& sh : m_shards)
+	{
+		s.items += sh.items.load(std::memory_order_relaxed);
+		s.bytes += sh.bytes.load(std::memory_order_relaxed);
+	}
+	return s;
+}
+
+template <typename clock_type>
+inline void sw::basic_rate_meter<clock_type>::restart(const sample& s) noexcept
+{
+	m_base = s;
+	// released, so that total_items() and total_bytes() never read shards older than the new base
+	m_base_items.store(s.items, std::memory_order_release);
+	m_base_bytes.store(s.bytes, std::memory_order_release);
+	m_last = s;
+	m_window[0] = s;
+	m_window_first = 0;
+	m_window_size = 1;
+	m_ewma_valid = false;
+	std::fill(m_ewma_items, m_ewma_items + rate_snapshot::ewma_count, 0.0);
+	std::fill(m_ewma_bytes, m_ewma_bytes + rate_snapshot::ewma_count, 0.0);
+}
+
+#endif
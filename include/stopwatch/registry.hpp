@@ -0,0 +1,441 @@
+#ifndef _STOPWATCH_REGISTRY_HPP_
+#define _STOPWATCH_REGISTRY_HPP_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+// maximum number of named timers in the registry
+#if !defined(STOPWATCH_REGISTRY_MAX_TIMERS)
+	#define STOPWATCH_REGISTRY_MAX_TIMERS 256
+#endif
+
+namespace sw
+{
+	using timer_id = std::uint32_t;
+
+	// aggregated statistics of one named timer
+	struct timer_stats
+	{
+		std::string_view name;
+		std::uint64_t count = 0;
+		std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+		std::chrono::nanoseconds min = std::chrono::nanoseconds::zero();
+		std::chrono::nanoseconds max = std::chrono::nanoseconds::zero();
+
+		/// Returns the mean time per call.
+		std::chrono::nanoseconds mean() const noexcept { return count == 0 ? std::chrono::nanoseconds::zero() : total / static_cast<std::int64_t>(count); }
+	};
+
+	// merged statistics of all named timers across all threads at the time of timer_registry::snapshot()
+	struct timer_report
+	{
+		std::vector<timer_stats> timers;
+		std::size_t thread_count = 0;
+
+		/**
+			* @brief Looks up the statistics of a timer.
+			* @param name	Timer name.
+			* @return		Pointer to the statistics, nullptr if no timer with this name exists.
+		*/
+		const timer_stats* find(std::string_view name) const noexcept;
+		/**
+			* @brief Prints one line per timer with call count, total, mean, min and max time.
+			* @tparam duration_type	Duration type for printing times.
+		*/
+		template <typename ostrm, typename duration_type = sw::microseconds_d>
+		void print(ostrm& s) const;
+	};
+
+	/*
+		Process wide registry of named timers. Every thread accumulates into its own block of slots, indexed by
+		timer id, which is only ever written by that thread; recording takes no locks and writes no shared cache
+		lines. snapshot() merges the blocks of all live threads and the totals of exited threads under a mutex
+		that is never taken on the recording path, except for recordings from thread_local destructors that run
+		after the thread's block was detached; those go into the totals of exited threads under the mutex.
+	*/
+	class timer_registry
+	{
+	public:
+		static constexpr std::size_t max_timers = STOPWATCH_REGISTRY_MAX_TIMERS;
+
+		/**
+			* @brief Returns the process wide registry. The registry is never destroyed, so timers can be
+			*		 recorded from static destructors and threads outliving main.
+		*/
+		static timer_registry& instance();
+		/**
+			* @brief Registers a named timer, or returns the id of the timer already registered under this name.
+			*		 Once max_timers are registered, further names get an id whose recordings are discarded.
+			* @param name	Timer name. Must outlive the registry, e.g. a string literal.
+			* @return		Timer id.
+		*/
+		timer_id register_timer(std::string_view name);
+		/**
+			* @brief Returns the name of a registered timer.
+			* @param id	Timer id.
+			* @return	Timer name, empty for an invalid id.
+		*/
+		std::string_view name(timer_id id) const noexcept;
+		/**
+			* @brief Returns the number of registered timers.
+		*/
+		std::size_t timer_count() const noexcept { return m_timer_count.load(std::memory_order_acquire); }
+		/**
+			* @brief Adds a measured duration to the calling thread's slot of a timer.
+			* @param id		Timer id from register_timer().
+			* @param d		Measured duration.
+			* @param weight	Number of calls the measurement stands for, e.g. the sampling period of a sampled timer.
+			*				Count and total grow by weight, min and max see the duration once.
+		*/
+		template <typename duration_type>
+		void record(timer_id id, const duration_type& d, std::uint64_t weight = 1) noexcept;
+		/**
+			* @brief Merges the slots of all threads.
+			* @return Statistics of every registered timer. Values recorded concurrently may or may not be included.
+		*/
+		timer_report snapshot() const;
+
+	private:
+		struct slot
+		{
+			std::atomic<std::uint64_t> count{0};
+			std::atomic<std::int64_t> total{0};
+			std::atomic<std::int64_t> min{INT64_MAX};
+			std::atomic<std::int64_t> max{0};
+		};
+		// one block per thread; the extra slot absorbs recordings of timers beyond max_timers
+		struct alignas(64) thread_slots
+		{
+			slot slots[max_timers + 1];
+		};
+		// slots of the calling thread; trivially destructible, so it stays valid until the thread is gone
+		struct thread_state
+		{
+			thread_slots* slots = nullptr;
+			bool detached = false;	// set once the thread's slots were merged into the retired totals
+		};
+		// detaches the calling thread's slots at thread exit
+		struct thread_guard
+		{
+			~thread_guard();
+		};
+
+		timer_registry() = default;
+		static thread_state& local_state() noexcept;
+		// returns nullptr once the calling thread's slots were detached
+		thread_slots* local_slots() noexcept;
+		thread_slots* attach_thread();
+		void detach_thread(thread_slots* slots);
+		void record_retired(std::size_t index, std::int64_t ns, std::uint64_t weight) noexcept;
+		static void accumulate(timer_stats& stats, const slot& s) noexcept;
+
+		mutable std::mutex m_mutex;
+		std::string_view m_names[max_timers];
+		std::atomic<std::size_t> m_timer_count{0};
+		std::vector<thread_slots*> m_threads;
+		thread_slots m_retired;
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		// stopwatch that starts on construction and records its elapsed time into a registry timer on destruction
+		template <typename clock_type>
+		class basic_registry_stopwatch : public basic_stopwatch<clock_type, std::chrono::nanoseconds, true, false>
+		{
+		public:
+			using base_t = basic_stopwatch<clock_type, std::chrono::nanoseconds, true, false>;
+
+			/**
+				* @brief Creates and starts a new basic_registry_stopwatch.
+				* @param id	Timer the elapsed time is recorded into.
+			*/
+			explicit basic_registry_stopwatch(timer_id id) : base_t(timer_registry::instance().name(id)), m_id(id) {}
+			basic_registry_stopwatch(const basic_registry_stopwatch&) = delete;
+			basic_registry_stopwatch& operator=(const basic_registry_stopwatch&) = delete;
+			/// Destructor. Stops the stopwatch and records the elapsed time.
+			~basic_registry_stopwatch()
+			{
+				if constexpr (stopwatch_enabled)
+				{
+					base_t::stop();
+					timer_registry::instance().record(m_id, base_t::elapsed_clock());
+				}
+			}
+
+		private:
+			timer_id m_id;
+		};
+	}
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		/*
+			Sampling counterpart of basic_registry_stopwatch for hot paths: only every sample_period-th construction
+			per call site and thread reads the clock, and its elapsed time is recorded with weight sample_period, so
+			that the count and total of the timer estimate those of timing every call. Skipped calls cost a decrement
+			of a thread_local countdown. Min and max are taken over the sampled calls only.
+		*/
+		template <typename clock_type>
+		class basic_sampled_registry_stopwatch
+		{
+		public:
+			using clock_t = clock_type;
+			using stopwatch_t = basic_stopwatch<clock_t, std::chrono::nanoseconds, false, false>;
+
+			/**
+				* @brief Creates a new basic_sampled_registry_stopwatch and starts it if this call is sampled.
+				* @param id				Timer the elapsed time is recorded into.
+				* @param countdown		Calls left until the next sample, a thread_local of the call site starting at 0.
+				* @param sample_period	Every sample_period-th call is timed, 0 and 1 time every call.
+			*/
+			basic_sampled_registry_stopwatch(timer_id id, std::uint32_t& countdown, std::uint32_t sample_period) noexcept;
+			basic_sampled_registry_stopwatch(const basic_sampled_registry_stopwatch&) = delete;
+			basic_sampled_registry_stopwatch& operator=(const basic_sampled_registry_stopwatch&) = delete;
+			/// Destructor. Stops the stopwatch and records the weighted elapsed time if this call is sampled.
+			~basic_sampled_registry_stopwatch();
+			/**
+				* @brief Returns whether this call is timed.
+			*/
+			bool sampled() const noexcept { return m_weight != 0; }
+
+		private:
+			timer_id m_id;
+			std::uint32_t m_weight;	// 0 for calls that are not sampled
+			stopwatch_t m_stopwatch;
+		};
+	}
+
+	using hres_registry_stopwatch 	= basic_registry_stopwatch<std::chrono::high_resolution_clock>;
+	using sys_registry_stopwatch 	= basic_registry_stopwatch<std::chrono::system_clock>;
+	using cpu_registry_stopwatch 	= basic_registry_stopwatch<cpu_clock>;
+	using tsc_registry_stopwatch 	= basic_registry_stopwatch<tsc_clock>;
+
+	using hres_sampled_registry_stopwatch 	= basic_sampled_registry_stopwatch<std::chrono::high_resolution_clock>;
+	using sys_sampled_registry_stopwatch 	= basic_sampled_registry_stopwatch<std::chrono::system_clock>;
+	using cpu_sampled_registry_stopwatch 	= basic_sampled_registry_stopwatch<cpu_clock>;
+	using tsc_sampled_registry_stopwatch 	= basic_sampled_registry_stopwatch<tsc_clock>;
+}
+
+#define STOPWATCH_CONCAT_IMPL(a, b) a##b
+#define STOPWATCH_CONCAT(a, b) STOPWATCH_CONCAT_IMPL(a, b)
+#if defined(STOPWATCH_DISABLE)
+	#define STOPWATCH_SCOPED_TIMER_AS(stopwatch_type, name) static_cast<void>(0)
+	#define STOPWATCH_SAMPLED_TIMER_AS(stopwatch_type, name, sample_period) static_cast<void>(0)
+#else
+	// times the rest of the enclosing scope into the named registry timer; the name is registered only once
+	#define STOPWATCH_SCOPED_TIMER_AS(stopwatch_type, name) \
+		static const ::sw::timer_id STOPWATCH_CONCAT(sw_timer_id_, __LINE__) = ::sw::timer_registry::instance().register_timer(name); \
+		stopwatch_type STOPWATCH_CONCAT(sw_timer_, __LINE__)(STOPWATCH_CONCAT(sw_timer_id_, __LINE__))
+	// times the rest of the enclosing scope into the named registry timer in every sample_period-th call of each thread
+	#define STOPWATCH_SAMPLED_TIMER_AS(stopwatch_type, name, sample_period) \
+		static const ::sw::timer_id STOPWATCH_CONCAT(sw_timer_id_, __LINE__) = ::sw::timer_registry::instance().register_timer(name); \
+		thread_local std::uint32_t STOPWATCH_CONCAT(sw_timer_countdown_, __LINE__) = 0; \
+		stopwatch_type STOPWATCH_CONCAT(sw_timer_, __LINE__)(STOPWATCH_CONCAT(sw_timer_id_, __LINE__), STOPWATCH_CONCAT(sw_timer_countdown_, __LINE__), sample_period)
+#endif
+#define STOPWATCH_SCOPED_TIMER(name) STOPWATCH_SCOPED_TIMER_AS(::sw::hres_registry_stopwatch, name)
+#define STOPWATCH_SAMPLED_TIMER(name, sample_period) STOPWATCH_SAMPLED_TIMER_AS(::sw::hres_sampled_registry_stopwatch, name, sample_period)
+
+// --- implementation ---
+
+inline const sw::timer_stats* sw::timer_report::find(std::string_view name) const noexcept
+{
+	const auto it = std::find_if(timers.begin(), timers.end(), [name](const timer_stats& t) { return t.name == name; });
+	return it == timers.end() ? nullptr : &*it;
+}
+
+template <typename ostrm, typename duration_type>
+inline void sw::timer_report::print(ostrm& s) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const std::chrono::nanoseconds& d)
+	{
+		const char* const end = sw::format_duration(buffer, as<duration_type>(d));
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	for (const timer_stats& t : timers)
+	{
+		s << t.name << ": calls " << t.count;
+		field(", total ", t.total);
+		field(", mean ", t.mean());
+		field(", min ", t.min);
+		field(", max ", t.max);
+		s << '\n';
+	}
+	s.flush();
+}
+
+inline sw::timer_registry& sw::timer_registry::instance()
+{
+	static timer_registry* const registry = new timer_registry();
+	return *registry;
+}
+
+inline sw::timer_id sw::timer_registry::register_timer(std::string_view name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const std::size_t count = m_timer_count.load(std::memory_order_relaxed);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		if (m_names[i] == name)
+			return static_cast<timer_id>(i);
+	}
+	if (count == max_timers)
+		return static_cast<timer_id>(max_timers);
+	m_names[count] = name;
+	m_timer_count.store(count + 1, std::memory_order_release);
+	return static_cast<timer_id>(count);
+}
+
+inline std::string_view sw::timer_registry::name(timer_id id) const noexcept
+{
+	return id < timer_count() ? m_names[id] : std::string_view{};
+}
+
+template <typename duration_type>
+inline void sw::timer_registry::record(timer_id id, const duration_type& d, std::uint64_t weight) noexcept
+{
+	const std::size_t index = std::min<std::size_t>(id, max_timers);
+	const std::int64_t ns = as<std::chrono::nanoseconds>(d).count();
+	thread_slots* const t = local_slots();
+	if (t == nullptr)
+	{
+		record_retired(index, ns, weight);
+		return;
+	}
+	// only the owning thread writes its slots, so plain load/store pairs suffice
+	slot& s = t->slots[index];
+	s.count.store(s.count.load(std::memory_order_relaxed) + weight, std::memory_order_relaxed);
+	s.total.store(s.total.load(std::memory_order_relaxed) + ns * static_cast<std::int64_t>(weight), std::memory_order_relaxed);
+	s.min.store(std::min(s.min.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+	s.max.store(std::max(s.max.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+}
+
+template <typename clock_type>
+inline sw::basic_sampled_registry_stopwatch<clock_type>::basic_sampled_registry_stopwatch(timer_id id, std::uint32_t& countdown, std::uint32_t sample_period) noexcept :
+	m_id(id),
+	m_weight(0),
+	m_stopwatch()
+{
+	if constexpr (stopwatch_enabled)
+	{
+		if (countdown != 0)
+		{
+			--countdown;
+			return;
+		}
+		m_weight = std::max<std::uint32_t>(sample_period, 1);
+		countdown = m_weight - 1;
+		m_stopwatch.start();
+	}
+}
+
+template <typename clock_type>
+inline sw::basic_sampled_registry_stopwatch<clock_type>::~basic_sampled_registry_stopwatch()
+{
+	if (m_weight != 0)
+	{
+		m_stopwatch.stop();
+		timer_registry::instance().record(m_id, m_stopwatch.elapsed_clock(), m_weight);
+	}
+}
+
+inline sw::timer_report sw::timer_registry::snapshot() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	timer_report report;
+	const std::size_t count = m_timer_count.load(std::memory_order_relaxed);
+	report.timers.resize(count);
+	report.thread_count = m_threads.size();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		timer_stats& stats = report.timers[i];
+		stats.name = m_names[i];
+		stats.min = std::chrono::nanoseconds{INT64_MAX};
+		accumulate(stats, m_retired.slots[i]);
+		for (const thread_slots* t : m_threads)
+			accumulate(stats, t->slots[i]);
+		if (stats.count == 0)
+			stats.min = std::chrono::nanoseconds::zero();
+	}
+	return report;
+}
+
+inline sw::timer_registry::thread_guard::~thread_guard()
+{
+	thread_state& state = local_state();
+	if (state.slots != nullptr)
+		timer_registry::instance().detach_thread(state.slots);
+	state.slots = nullptr;
+	state.detached = true;
+}
+
+inline sw::timer_registry::thread_state& sw::timer_registry::local_state() noexcept
+{
+	thread_local thread_state state;
+	return state;
+}
+
+inline sw::timer_registry::thread_slots* sw::timer_registry::local_slots() noexcept
+{
+	thread_state& state = local_state();
+	if (state.slots == nullptr && !state.detached)
+		state.slots = attach_thread();
+	return state.slots;
+}
+
+inline sw::timer_registry::thread_slots* sw::timer_registry::attach_thread()
+{
+	thread_local thread_guard guard;
+	static_cast<void>(guard);
+	thread_slots* const slots = new thread_slots();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_threads.push_back(slots);
+	return slots;
+}
+
+inline void sw::timer_registry::detach_thread(thread_slots* slots)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (std::size_t i = 0; i < max_timers; ++i)
+	{
+		const slot& s = slots->slots[i];
+		slot& r = m_retired.slots[i];
+		r.count.store(r.count.load(std::memory_order_relaxed) + s.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		r.total.store(r.total.load(std::memory_order_relaxed) + s.total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		r.min.store(std::min(r.min.load(std::memory_order_relaxed), s.min.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+		r.max.store(std::max(r.max.load(std::memory_order_relaxed), s.max.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+	}
+	m_threads.erase(std::remove(m_threads.begin(), m_threads.end(), slots), m_threads.end());
+	delete slots;
+}
+
+inline void sw::timer_registry::record_retired(std::size_t index, std::int64_t ns, std::uint64_t weight) noexcept
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	slot& r = m_retired.slots[index];
+	r.count.store(r.count.load(std::memory_order_relaxed) + weight, std::memory_order_relaxed);
+	r.total.store(r.total.load(std::memory_order_relaxed) + ns * static_cast<std::int64_t>(weight), std::memory_order_relaxed);
+	r.min.store(std::min(r.min.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+	r.max.store(std::max(r.max.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+}
+
+inline void sw::timer_registry::accumulate(timer_stats& stats, const slot& s) noexcept
+{
+	const std::uint64_t count = s.count.load(std::memory_order_relaxed);
+	if (count == 0)
+		return;
+	stats.count += count;
+	stats.total += std::chrono::nanoseconds{s.total.load(std::memory_order_relaxed)};
+	stats.min = std::min(stats.min, std::chrono::nanoseconds{s.min.load(std::memory_order_relaxed)});
+	stats.max = std::max(stats.max, std::chrono::nanoseconds{s.max.load(std::memory_order_relaxed)});
+}
+
+#endif
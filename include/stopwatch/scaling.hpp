@@ -0,0 +1,357 @@
+#ifndef _STOPWATCH_SCALING_HPP_
+#define _STOPWATCH_SCALING_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+// threads can be pinned to cores on linux
+#if !defined(STOPWATCH_HAS_THREAD_AFFINITY)
+	#if defined(__linux__) && __has_include(<pthread.h>) && __has_include(<sched.h>)
+		#include <pthread.h>
+		#include <sched.h>
+		#define STOPWATCH_HAS_THREAD_AFFINITY 1
+	#else
+		#define STOPWATCH_HAS_THREAD_AFFINITY 0
+	#endif
+#endif
+
+namespace sw
+{
+	namespace bench
+	{
+		// how the work grows with the number of threads
+		enum class scaling_mode
+		{
+			strong,	// fixed total work split among the threads
+			weak	// fixed work per thread
+		};
+
+		// scaling study settings
+		struct scaling_config
+		{
+			std::vector<std::size_t> thread_counts;	// empty: powers of two up to std::thread::hardware_concurrency(), and the concurrency itself
+			std::size_t repetitions = 5;			// runs per thread count, the run with the median wall time is reported
+			std::size_t warmup_runs = 1;			// untimed runs per thread count
+			bool pin_threads = false;				// pins thread i to the i-th cpu of the calling thread's affinity mask, modulo its size (linux only)
+			scaling_mode mode = scaling_mode::strong;
+		};
+
+		// timings of one thread count
+		struct scaling_result
+		{
+			std::string name;
+			std::size_t threads = 0;
+			nanoseconds_d wall{0.0};		// from the synchronized start until the last thread finished
+			nanoseconds_d cpu{0.0};			// summed thread cpu time of the timed calls, 0 without a per thread cpu clock
+			nanoseconds_d thread_min{0.0};	// per thread wall times
+			nanoseconds_d thread_mean{0.0};
+			nanoseconds_d thread_max{0.0};
+			double speedup = 0.0;			// relative to the first thread count, scaled by its thread count
+			double efficiency = 0.0;		// speedup per thread
+			double imbalance = 0.0;			// thread_max / thread_mean, 1 for perfectly balanced threads
+			double cores_used = 0.0;		// cpu / wall
+		};
+
+		/*
+			Runs a callable on an increasing number of threads and measures how it scales. The calling thread takes
+			part as thread 0; all threads wait at a barrier and start together. Every thread is timed with its own
+			wall clock and thread_cpu_clock stopwatch around the callable, so waiting at the barrier does not count
+			as cpu time; the run lasts from the release until the last thread finished. Speedup and efficiency are
+			relative to the first thread count; in weak scaling mode the speedup is the scaled speedup n * T(1) / T(n).
+			Measurements are meaningless in translation units built with STOPWATCH_DISABLE.
+		*/
+		class scaling_study
+		{
+		public:
+			using wall_stopwatch_t = basic_stopwatch<std::chrono::steady_clock, sw::nanoseconds_d, false, false>;
+			using cpu_stopwatch_t = basic_stopwatch<thread_cpu_clock, sw::nanoseconds_d, false, false>;
+
+			explicit scaling_study(const scaling_config& c = scaling_config{}) : m_config(c), m_results() {}
+			/**
+				* @brief Runs a callable for every configured thread count.
+				* @param name	Name of the study.
+				* @param f		Callable invoked by every thread as f(thread_index, thread_count).
+			*/
+			template <typename fn>
+			void run(std::string_view name, fn&& f);
+			/// Returns the settings, which may be changed between runs, e.g. to switch the scaling mode.
+			scaling_config& config() noexcept { return m_config; }
+			/// Returns the results of all studies run so far, one per thread count.
+			const std::vector<scaling_result>& results() const noexcept { return m_results; }
+			/**
+				* @brief Prints a human readable table of all results.
+			*/
+			template <typename ostrm>
+			void report(ostrm& s) const;
+			/**
+				* @brief Writes all results as csv with a header line. Times are in nanoseconds.
+			*/
+			template <typename ostrm>
+			void write_csv(ostrm& s) const;
+			/**
+				* @brief Writes all results as a json object with a "scaling" array. Times are in nanoseconds.
+			*/
+			template <typename ostrm>
+			void write_json(ostrm& s) const;
+
+		private:
+			struct run_times
+			{
+				nanoseconds_d wall;
+				nanoseconds_d cpu;
+				std::vector<nanoseconds_d> threads;
+			};
+
+			template <typename fn>
+			run_times run_once(fn& f, std::size_t thread_count) const;
+			std::vector<std::size_t> thread_counts() const;
+			static void pin_current_thread(std::size_t index) noexcept;
+
+			scaling_config m_config;
+			std::vector<scaling_result> m_results;
+		};
+	}
+}
+
+// --- implementation ---
+
+template <typename fn>
+inline void sw::bench::scaling_study::run(std::string_view name, fn&& f)
+{
+	static_assert(stopwatch_enabled || sizeof(fn) == 0, "scaling_study needs stopwatches, do not define STOPWATCH_DISABLE");
+	const std::size_t first = m_results.size();
+	for (const std::size_t thread_count : thread_counts())
+	{
+		for (std::size_t i = 0; i < m_config.warmup_runs; ++i)
+			run_once(f, thread_count);
+		std::vector<run_times> runs;
+		for (std::size_t i = 0; i < std::max<std::size_t>(m_config.repetitions, 1); ++i)
+			runs.push_back(run_once(f, thread_count));
+		std::sort(runs.begin(), runs.end(), [](const run_times& a, const run_times& b) { return a.wall < b.wall; });
+		const run_times& median = runs[runs.size() / 2];
+
+		scaling_result r;
+		r.name.assign(name);
+		r.threads = thread_count;
+		r.wall = median.wall;
+		r.cpu = median.cpu;
+		r.thread_min = *std::min_element(median.threads.begin(), median.threads.end());
+		r.thread_max = *std::max_element(median.threads.begin(), median.threads.end());
+		for (const nanoseconds_d& t : median.threads)
+			r.thread_mean += t;
+		r.thread_mean /= static_cast<double>(thread_count);
+		r.imbalance = r.thread_mean.count() > 0.0 ? r.thread_max / r.thread_mean : 0.0;
+		r.cores_used = r.wall.count() > 0.0 ? r.cpu / r.wall : 0.0;
+		m_results.push_back(std::move(r));
+	}
+	if (first == m_results.size())
+		return;
+	const scaling_result& base = m_results[first];
+	for (std::size_t i = first; i < m_results.size(); ++i)
+	{
+		scaling_result& r = m_results[i];
+		if (r.wall.count() <= 0.0)
+			continue;
+		const double ratio = base.wall / r.wall;
+		r.speedup = m_config.mode == scaling_mode::strong ? ratio * static_cast<double>(base.threads)
+														  : ratio * static_cast<double>(r.threads);
+		r.efficiency = r.speedup / static_cast<double>(r.threads);
+	}
+}
+
+template <typename fn>
+inline sw::bench::scaling_study::run_times sw::bench::scaling_study::run_once(fn& f, std::size_t thread_count) const
+{
+	using time_point_t = wall_stopwatch_t::clock_time_point_t;
+	std::atomic<std::size_t> ready{0};
+	std::atomic<bool> go{false};
+	run_times times{nanoseconds_d{0.0}, nanoseconds_d{0.0}, std::vector<nanoseconds_d>(thread_count)};
+	std::vector<nanoseconds_d> cpu_times(thread_count, nanoseconds_d{0.0});
+	std::vector<time_point_t> ends(thread_count);
+
+	// only the callable is timed, waiting at the barrier and for the other threads costs no cpu time here
+	const auto timed = [&](std::size_t index)
+	{
+		wall_stopwatch_t s;
+		cpu_stopwatch_t cpu;
+		cpu.start();
+		s.start();
+		f(index, thread_count);
+		ends[index] = s.stop();
+		cpu.stop();
+		times.threads[index] = s.elapsed();
+		cpu_times[index] = as<nanoseconds_d>(cpu.elapsed_clock());
+	};
+	const auto body = [&](std::size_t index)
+	{
+		if (m_config.pin_threads)
+			pin_current_thread(index);
+		ready.fetch_add(1);
+		while (!go.load(std::memory_order_acquire))
+			std::this_thread::yield();
+		timed(index);
+	};
+
+#if STOPWATCH_HAS_THREAD_AFFINITY
+	cpu_set_t previous_affinity;
+	const bool restore_affinity = m_config.pin_threads && pthread_getaffinity_np(pthread_self(), sizeof(previous_affinity), &previous_affinity) == 0;
+#endif
+	std::vector<std::thread> threads;
+	threads.reserve(thread_count - 1);
+	for (std::size_t i = 1; i < thread_count; ++i)
+		threads.emplace_back(body, i);
+	if (m_config.pin_threads)
+		pin_current_thread(0);
+	while (ready.load() != thread_count - 1)
+		std::this_thread::yield();
+
+	// thread 0 releases the others and runs its share, the run ends when the last thread finished
+	wall_stopwatch_t wall;
+	ready.fetch_add(1);
+	const time_point_t start = wall.start();
+	go.store(true, std::memory_order_release);
+	timed(0);
+	for (std::thread& t : threads)
+		t.join();
+#if STOPWATCH_HAS_THREAD_AFFINITY
+	if (restore_affinity)
+		pthread_setaffinity_np(pthread_self(), sizeof(previous_affinity), &previous_affinity);
+#endif
+	times.wall = as<nanoseconds_d>(*std::max_element(ends.begin(), ends.end()) - start);
+	// without a per thread cpu clock every reading is process cpu time, which cannot be summed
+	if (cpu_stopwatch_t::clock_t::is_thread_time)
+	{
+		for (const nanoseconds_d& t : cpu_times)
+			times.cpu += t;
+	}
+	return times;
+}
+
+inline std::vector<std::size_t> sw::bench::scaling_study::thread_counts() const
+{
+	if (!m_config.thread_counts.empty())
+	{
+		std::vector<std::size_t> counts;
+		for (const std::size_t n : m_config.thread_counts)
+		{
+			if (n != 0)
+				counts.push_back(n);
+		}
+		return counts;
+	}
+	const std::size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<std::size_t> counts;
+	for (std::size_t n = 1; n < cores; n *= 2)
+		counts.push_back(n);
+	counts.push_back(cores);
+	return counts;
+}
+
+inline void sw::bench::scaling_study::pin_current_thread(std::size_t index) noexcept
+{
+#if STOPWATCH_HAS_THREAD_AFFINITY
+	// threads inherit the affinity of the calling thread, pick the index-th cpu of that mask
+	cpu_set_t allowed;
+	if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0)
+		return;
+	const int count = CPU_COUNT(&allowed);
+	if (count <= 0)
+		return;
+	std::size_t n = index % static_cast<std::size_t>(count);
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (!CPU_ISSET(cpu, &allowed) || n-- != 0)
+			continue;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		return;
+	}
+#else
+	static_cast<void>(index);
+#endif
+}
+
+template <typename ostrm>
+inline void sw::bench::scaling_study::report(ostrm& s) const
+{
+	char buffer[sw::max_duration_str_length];
+	const auto field = [&](const char* label, const nanoseconds_d& d)
+	{
+		const char* const end = sw::format_duration(buffer, as<sw::milliseconds_d>(d));
+		s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+	};
+	for (const scaling_result& r : m_results)
+	{
+		s << r.name << '/' << r.threads;
+		field(": wall ", r.wall);
+		field(", cpu ", r.cpu);
+		field(", thread min ", r.thread_min);
+		field(", mean ", r.thread_mean);
+		field(", max ", r.thread_max);
+		s << ", speedup " << r.speedup << ", efficiency " << r.efficiency << ", imbalance " << r.imbalance << ", cores used " << r.cores_used << '\n';
+	}
+	s.flush();
+}
+
+template <typename ostrm>
+inline void sw::bench::scaling_study::write_csv(ostrm& s) const
+{
+	s << "name,threads,wall_ns,cpu_ns,thread_min_ns,thread_mean_ns,thread_max_ns,speedup,efficiency,imbalance,cores_used\n";
+	for (const scaling_result& r : m_results)
+	{
+		// quote names, doubling embedded quotes
+		s << '"';
+		for (const char c : r.name)
+			s << (c == '"' ? "\"\"" : std::string_view(&c, 1));
+		s << "\"," << r.threads << ',' << r.wall.count() << ',' << r.cpu.count() << ',' << r.thread_min.count() << ','
+		  << r.thread_mean.count() << ',' << r.thread_max.count() << ',' << r.speedup << ',' << r.efficiency << ','
+		  << r.imbalance << ',' << r.cores_used << '\n';
+	}
+	s.flush();
+}
+
+template <typename ostrm>
+inline void sw::bench::scaling_study::write_json(ostrm& s) const
+{
+	std::string out = "{\"scaling\":[";
+	char buffer[sw::max_duration_str_length];
+	const auto number = [&](const char* key, double value)
+	{
+		out += key;
+		out.append(buffer, sw::format_count(buffer, value));
+	};
+	for (std::size_t i = 0; i < m_results.size(); ++i)
+	{
+		const scaling_result& r = m_results[i];
+		out += i == 0 ? "\n{\"name\":" : ",\n{\"name\":";
+		sw::detail::append_json_string(out, r.name);
+		out += ",\"threads\":" + std::to_string(r.threads);
+		number(",\"wall_ns\":", r.wall.count());
+		number(",\"cpu_ns\":", r.cpu.count());
+		number(",\"thread_min_ns\":", r.thread_min.count());
+		number(",\"thread_mean_ns\":", r.thread_mean.count());
+		number(",\"thread_max_ns\":", r.thread_max.count());
+		number(",\"speedup\":", r.speedup);
+		number(",\"efficiency\":", r.efficiency);
+		number(",\"imbalance\":", r.imbalance);
+		number(",\"cores_used\":", r.cores_used);
+		out += '}';
+	}
+	out += "\n]}\n";
+	s << out;
+	s.flush();
+}
+
+#endif
@@ -0,0 +1,395 @@
+#ifndef _STOPWATCH_SHM_EXPORT_HPP_
+#define _STOPWATCH_SHM_EXPORT_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <stopwatch/common.hpp>
+#include <stopwatch/registry.hpp>
+
+// shared memory export needs posix file mapping
+#if !defined(STOPWATCH_HAS_SHM_EXPORT)
+	#if __has_include(<sys/mman.h>) && __has_include(<fcntl.h>) && __has_include(<unistd.h>)
+		#include <fcntl.h>
+		#include <sys/mman.h>
+		#include <sys/stat.h>
+		#include <unistd.h>
+		#define STOPWATCH_HAS_SHM_EXPORT 1
+	#else
+		#define STOPWATCH_HAS_SHM_EXPORT 0
+	#endif
+#endif
+// directory of the exported metrics files
+#if !defined(STOPWATCH_SHM_DIR)
+	#define STOPWATCH_SHM_DIR "/dev/shm"
+#endif
+
+namespace sw
+{
+	// header at the start of an exported metrics file
+	struct alignas(64) shm_metrics_header
+	{
+		static constexpr char magic_value[8] = {'S', 'W', 'M', 'E', 'T', 'R', 'I', 'C'};
+		static constexpr std::uint32_t current_version = 1;
+
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t slot_capacity;				// number of slots following the header
+		std::uint64_t pid;							// exporting process
+		std::atomic<std::uint64_t> timer_count;		// slots in use, slot i holds registry timer i
+		std::atomic<std::uint64_t> thread_count;	// recording threads alive at the last publish
+		std::atomic<std::uint64_t> publish_count;	// number of publishes so far
+		std::atomic<std::int64_t> published_ns;		// steady_clock time of the last publish
+	};
+
+	// statistics of one timer; the exporter is the only writer, readers retry while the sequence is odd or changes
+	struct alignas(64) shm_timer_slot
+	{
+		static constexpr std::size_t max_name_length = 87;
+
+		std::atomic<std::uint64_t> sequence;
+		std::atomic<std::uint64_t> count;
+		std::atomic<std::int64_t> total_ns;
+		std::atomic<std::int64_t> min_ns;
+		std::atomic<std::int64_t> max_ns;
+		char name[max_name_length + 1];	// written once before the slot is counted in timer_count
+	};
+
+	static_assert(std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::int64_t>::is_always_lock_free,
+		"shared memory export requires lock-free 64 bit atomics");
+
+	/*
+		Exports the statistics of all registry timers into a memory mapped file under STOPWATCH_SHM_DIR, so that other
+		processes can watch them live, e.g. with the stopwatch_shm_reader tool. Every timer has a fixed slot protected
+		by a sequence lock. publish() takes a registry snapshot and copies it into the slots; the background thread of
+		start() publishes periodically. Recording threads are never involved, and readers can neither block the
+		exporter nor stall the process. The file is removed when the exporter is closed.
+	*/
+	class shm_exporter
+	{
+	public:
+		static constexpr std::size_t slot_capacity = timer_registry::max_timers;
+
+		shm_exporter() = default;
+		shm_exporter(const shm_exporter&) = delete;
+		shm_exporter& operator=(const shm_exporter&) = delete;
+		/// Destructor. Stops publishing and removes the file.
+		~shm_exporter() { close(); }
+		/**
+			* @brief Returns the default file name of the calling process, "stopwatch.<pid>".
+		*/
+		static std::string default_name();
+		/**
+			* @brief Creates the metrics file, replacing an existing file of the same name.
+			* @param name	File name inside STOPWATCH_SHM_DIR, default_name() if empty.
+			* @return		Whether the file was created and mapped.
+		*/
+		bool open(std::string_view name = {});
+		/**
+			* @brief Stops publishing, unmaps and removes the file.
+		*/
+		void close();
+		bool is_open() const noexcept { return m_header != nullptr; }
+		/**
+			* @brief Returns the path of the metrics file.
+		*/
+		const std::string& path() const noexcept { return m_path; }
+		/**
+			* @brief Takes a registry snapshot and writes it into the slots. Safe to call while the background thread
+			*		 of start() runs, publishes are serialized so that every slot keeps a single writer.
+		*/
+		void publish();
+		/**
+			* @brief Starts a background thread calling publish() periodically.
+			* @param interval	Time between publishes.
+		*/
+		void start(std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+		/**
+			* @brief Stops the background thread after a final publish.
+		*/
+		void stop();
+
+	private:
+		std::string m_path;
+		shm_metrics_header* m_header = nullptr;
+		shm_timer_slot* m_slots = nullptr;
+		std::size_t m_size = 0;
+		std::thread m_thread;
+		std::mutex m_publish_mutex;	// serializes publish(), the sequence locks allow one writer only
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		bool m_stop = false;
+	};
+
+	// consistent copy of an exported metrics file
+	struct shm_metrics
+	{
+		std::uint64_t pid = 0;
+		std::uint64_t publish_count = 0;
+		std::chrono::nanoseconds published{0};	// steady_clock time of the publish
+		timer_report report;					// timer names point into the mapping of the reader
+		std::size_t torn_slots = 0;				// slots skipped because they were rewritten during every read attempt
+	};
+
+	// read-only view of a metrics file exported by shm_exporter, possibly of another process
+	class shm_reader
+	{
+	public:
+		shm_reader() = default;
+		shm_reader(const shm_reader&) = delete;
+		shm_reader& operator=(const shm_reader&) = delete;
+		~shm_reader() { detach(); }
+		/**
+			* @brief Maps a metrics file.
+			* @param name	File name inside STOPWATCH_SHM_DIR, or an absolute path.
+			* @return		Whether the file exists and has a valid header.
+		*/
+		bool attach(std::string_view name);
+		void detach();
+		bool is_attached() const noexcept { return m_header != nullptr; }
+		/**
+			* @brief Copies header and slots. Never waits for the exporter: a slot that is rewritten during every
+			*		 one of a few read attempts is skipped and counted in torn_slots.
+			* @param m	Destination, reusing the storage of previous reads.
+			* @return	Whether a reader is attached.
+		*/
+		bool read(shm_metrics& m) const;
+
+	private:
+		const shm_metrics_header* m_header = nullptr;
+		const shm_timer_slot* m_slots = nullptr;
+		std::size_t m_size = 0;
+	};
+}
+
+// --- implementation ---
+
+inline std::string sw::shm_exporter::default_name()
+{
+#if STOPWATCH_HAS_SHM_EXPORT
+	return "stopwatch." + std::to_string(static_cast<long long>(::getpid()));
+#else
+	return "stopwatch";
+#endif
+}
+
+inline bool sw::shm_exporter::open(std::string_view name)
+{
+	close();
+#if STOPWATCH_HAS_SHM_EXPORT
+	const std::string path = std::string(STOPWATCH_SHM_DIR "/").append(name.empty() ? default_name() : std::string(name));
+	const std::size_t size = sizeof(shm_metrics_header) + slot_capacity * sizeof(shm_timer_slot);
+	::unlink(path.c_str());
+	const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return false;
+	if (::ftruncate(fd, static_cast<off_t>(size)) != 0)
+	{
+		::close(fd);
+		::unlink(path.c_str());
+		return false;
+	}
+	void* const mapping = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		::unlink(path.c_str());
+		return false;
+	}
+	// the file is zero filled, which is a valid state of every atomic; the magic is written last
+	m_header = static_cast<shm_metrics_header*>(mapping);
+	m_slots = reinterpret_cast<shm_timer_slot*>(static_cast<char*>(mapping) + sizeof(shm_metrics_header));
+	m_size = size;
+	m_path = path;
+	m_header->version = shm_metrics_header::current_version;
+	m_header->slot_capacity = static_cast<std::uint32_t>(slot_capacity);
+	m_header->pid = static_cast<std::uint64_t>(::getpid());
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(m_header->magic, shm_metrics_header::magic_value, sizeof(m_header->magic));
+	return true;
+#else
+	static_cast<void>(name);
+	return false;
+#endif
+}
+
+inline void sw::shm_exporter::close()
+{
+	stop();
+#if STOPWATCH_HAS_SHM_EXPORT
+	if (m_header != nullptr)
+	{
+		::munmap(m_header, m_size);
+		::unlink(m_path.c_str());
+	}
+#endif
+	m_header = nullptr;
+	m_slots = nullptr;
+	m_size = 0;
+	m_path.clear();
+}
+
+inline void sw::shm_exporter::publish()
+{
+	std::lock_guard<std::mutex> lock(m_publish_mutex);
+	if (m_header == nullptr)
+		return;
+	const timer_report report = timer_registry::instance().snapshot();
+	const std::size_t count = std::min(report.timers.size(), slot_capacity);
+	const std::size_t previous = m_header->timer_count.load(std::memory_order_relaxed);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const timer_stats& t = report.timers[i];
+		shm_timer_slot& slot = m_slots[i];
+		if (i >= previous)
+		{
+			const std::size_t length = std::min(t.name.size(), shm_timer_slot::max_name_length);
+			std::memcpy(slot.name, t.name.data(), length);
+			slot.name[length] = '\0';
+		}
+		// sequence lock with a single writer
+		const std::uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.count.store(t.count, std::memory_order_relaxed);
+		slot.total_ns.store(t.total.count(), std::memory_order_relaxed);
+		slot.min_ns.store(t.min.count(), std::memory_order_relaxed);
+		slot.max_ns.store(t.max.count(), std::memory_order_relaxed);
+		slot.sequence.store(sequence + 2, std::memory_order_release);
+	}
+	m_header->thread_count.store(report.thread_count, std::memory_order_relaxed);
+	m_header->published_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+	m_header->timer_count.store(std::max(previous, count), std::memory_order_release);
+	m_header->publish_count.fetch_add(1, std::memory_order_release);
+}
+
+inline void sw::shm_exporter::start(std::chrono::milliseconds interval)
+{
+	stop();
+	if (m_header == nullptr)
+		return;
+	m_stop = false;
+	m_thread = std::thread([this, interval]()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stop)
+		{
+			lock.unlock();
+			publish();
+			lock.lock();
+			m_wake.wait_for(lock, interval, [this]() { return m_stop; });
+		}
+	});
+}
+
+inline void sw::shm_exporter::stop()
+{
+	if (!m_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	m_thread.join();
+	publish();
+}
+
+inline bool sw::shm_reader::attach(std::string_view name)
+{
+	detach();
+#if STOPWATCH_HAS_SHM_EXPORT
+	const std::string path = !name.empty() && name.front() == '/' ? std::string(name) : std::string(STOPWATCH_SHM_DIR "/").append(name);
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(shm_metrics_header))
+	{
+		::close(fd);
+		return false;
+	}
+	const std::size_t size = static_cast<std::size_t>(st.st_size);
+	void* const mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	const shm_metrics_header* const header = static_cast<const shm_metrics_header*>(mapping);
+	const bool valid = std::memcmp(header->magic, shm_metrics_header::magic_value, sizeof(header->magic)) == 0
+		&& header->version == shm_metrics_header::current_version
+		&& sizeof(shm_metrics_header) + header->slot_capacity * sizeof(shm_timer_slot) <= size;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (!valid)
+	{
+		::munmap(mapping, size);
+		return false;
+	}
+	m_header = header;
+	m_slots = reinterpret_cast<const shm_timer_slot*>(static_cast<const char*>(mapping) + sizeof(shm_metrics_header));
+	m_size = size;
+	return true;
+#else
+	static_cast<void>(name);
+	return false;
+#endif
+}
+
+inline void sw::shm_reader::detach()
+{
+#if STOPWATCH_HAS_SHM_EXPORT
+	if (m_header != nullptr)
+		::munmap(const_cast<shm_metrics_header*>(m_header), m_size);
+#endif
+	m_header = nullptr;
+	m_slots = nullptr;
+	m_size = 0;
+}
+
+inline bool sw::shm_reader::read(shm_metrics& m) const
+{
+	if (m_header == nullptr)
+		return false;
+	constexpr int max_attempts = 16;
+	m.pid = m_header->pid;
+	m.publish_count = m_header->publish_count.load(std::memory_order_acquire);
+	m.published = std::chrono::nanoseconds{m_header->published_ns.load(std::memory_order_relaxed)};
+	m.report.thread_count = m_header->thread_count.load(std::memory_order_relaxed);
+	m.report.timers.clear();
+	m.torn_slots = 0;
+	const std::size_t count = std::min<std::size_t>(m_header->timer_count.load(std::memory_order_acquire), m_header->slot_capacity);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		const shm_timer_slot& slot = m_slots[i];
+		timer_stats t;
+		bool consistent = false;
+		for (int attempt = 0; attempt < max_attempts && !consistent; ++attempt)
+		{
+			const std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+			if (sequence % 2 != 0)
+				continue;
+			t.count = slot.count.load(std::memory_order_relaxed);
+			t.total = std::chrono::nanoseconds{slot.total_ns.load(std::memory_order_relaxed)};
+			t.min = std::chrono::nanoseconds{slot.min_ns.load(std::memory_order_relaxed)};
+			t.max = std::chrono::nanoseconds{slot.max_ns.load(std::memory_order_relaxed)};
+			std::atomic_thread_fence(std::memory_order_acquire);
+			consistent = slot.sequence.load(std::memory_order_relaxed) == sequence;
+		}
+		if (!consistent)
+		{
+			++m.torn_slots;
+			continue;
+		}
+		t.name = std::string_view(slot.name, static_cast<std::size_t>(std::find(slot.name, slot.name + sizeof(slot.name), '\0') - slot.name));
+		m.report.timers.push_back(t);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,561 @@
+#ifndef _STOPWATCH_SINK_HPP_
+#define _STOPWATCH_SINK_HPP_
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <stopwatch/common.hpp>
+
+// number of records buffered by the async sink, rounded up to a power of two
+#if !defined(STOPWATCH_ASYNC_SINK_CAPACITY)
+	#define STOPWATCH_ASYNC_SINK_CAPACITY 4096
+#endif
+// behaviour of the async sink when its buffer is full, one of sw::sink_overflow_policy
+#if !defined(STOPWATCH_ASYNC_SINK_OVERFLOW_POLICY)
+	#define STOPWATCH_ASYNC_SINK_OVERFLOW_POLICY ::sw::sink_overflow_policy::drop_newest
+#endif
+
+namespace sw
+{
+	// what happens to a report submitted while the async sink buffer is full
+	enum class sink_overflow_policy
+	{
+		drop_newest,		// the new report is discarded
+		overwrite_oldest	// the oldest buffered report is discarded to make room
+	};
+
+	// fixed size binary report of a stopped stopwatch, formatted by the async sink's background thread
+	struct report_record
+	{
+		static constexpr std::size_t max_name_length = 39;
+		static constexpr std::size_t max_fields = 5;
+		static constexpr std::size_t max_label_length = 16;
+		// longest line format() writes, including the newline
+		static constexpr std::size_t max_formatted_length = max_name_length + max_duration_str_length + max_fields * (2 + max_label_length + 1 + max_duration_str_length) + 1;
+
+		// labeled value printed after the elapsed time, e.g. the counters of a perf stopwatch
+		struct field
+		{
+			const char* label;			// a string literal, truncated to max_label_length characters
+			const char* unit;			// unit postfix, a string literal, or nullptr for plain counts
+			bool integral;
+			union
+			{
+				double float_value;
+				std::int64_t int_value;
+			};
+		};
+
+		char name[max_name_length + 1];	// truncated copy of the stopwatch name, so that it may dangle afterwards
+		std::uint8_t name_length;
+		bool integral;					// which member of the value union is valid
+		std::uint8_t field_count;
+		union
+		{
+			double float_value;
+			std::int64_t int_value;
+		};
+		const char* unit;				// unit postfix, a string literal
+		field fields[max_fields];
+
+		/**
+			* @brief Creates a record from a name and an elapsed duration.
+			* @param n	Name, truncated to max_name_length characters.
+			* @param d	Elapsed time.
+		*/
+		template <typename duration_type>
+		static report_record make(std::string_view n, const duration_type& d) noexcept;
+		/**
+			* @brief Appends a count, printed as ", label value" or ", label value unit". Ignored once max_fields fields were added.
+			* @param label			Label, a string literal.
+			* @param v				Integral or floating point value.
+			* @param unit_postfix	Unit postfix, a string literal, or nullptr.
+		*/
+		template <typename value_type>
+		void add_count(const char* label, value_type v, const char* unit_postfix = nullptr) noexcept;
+		/**
+			* @brief Appends a duration, printed as ", label value unit". Ignored once max_fields fields were added.
+			* @param label	Label, a string literal.
+			* @param d		Duration.
+		*/
+		template <typename duration_type>
+		void add_duration(const char* label, const duration_type& d) noexcept;
+		/**
+			* @brief Formats the record like basic_stopwatch::report_elapsed() does, followed by the fields and a newline.
+			* @param first	Output buffer of at least max_formatted_length characters.
+			* @return		Pointer past the last written character.
+		*/
+		char* format(char* first) const noexcept;
+	};
+
+	namespace detail
+	{
+		// detects stopwatches that build their own report record, e.g. to add counters to the elapsed time
+		template <typename stopwatch_type, typename = void>
+		struct has_report_record : std::false_type {};
+		template <typename stopwatch_type>
+		struct has_report_record<stopwatch_type, std::void_t<decltype(std::declval<const stopwatch_type&>().make_report_record())>> : std::true_type {};
+
+		// bounded lock-free multi producer multi consumer queue (D. Vyukov), every cell carries a sequence number
+		template <typename value_type>
+		class bounded_queue
+		{
+		public:
+			explicit bounded_queue(std::size_t capacity);
+			bool try_push(const value_type& v) noexcept;
+			bool try_pop(value_type& v) noexcept;
+			std::size_t capacity() const noexcept { return m_mask + 1; }
+
+		private:
+			struct cell
+			{
+				std::atomic<std::size_t> sequence;
+				value_type value;
+			};
+
+			std::unique_ptr<cell[]> m_cells;
+			std::size_t m_mask;
+			alignas(64) std::atomic<std::size_t> m_enqueue_pos;
+			alignas(64) std::atomic<std::size_t> m_dequeue_pos;
+		};
+
+		/*
+			Background thread that sleeps on a condition variable until a producer signals new work, then calls the
+			drain function until it finds nothing left. The thread is started by the first signal, so a process that
+			never queues anything never starts it. Producers only take the mutex while the thread sleeps.
+		*/
+		class wakeup_worker
+		{
+		public:
+			using drain_fn = std::size_t (*)(void* context);
+
+			/**
+				* @brief Creates a worker without starting its thread.
+				* @param drain		Processes queued work and returns the number of processed items. Called on the worker thread only.
+				* @param context	Argument of drain.
+			*/
+			wakeup_worker(drain_fn drain, void* context) noexcept;
+			wakeup_worker(const wakeup_worker&) = delete;
+			wakeup_worker& operator=(const wakeup_worker&) = delete;
+			~wakeup_worker() { stop(); }
+			/**
+				* @brief Wakes the thread, starting it if needed. Call after publishing work. Never throws; if the thread
+				*		 can not be started, the work stays queued.
+			*/
+			void signal() noexcept;
+			/**
+				* @brief Stops and joins the thread. Work queued afterwards is not processed by the worker.
+			*/
+			void stop();
+
+		private:
+			void run();
+
+			drain_fn m_drain;
+			void* m_context;
+			std::atomic<bool> m_idle;	// true while the thread sleeps or is not started, producers skip the wakeup otherwise
+			bool m_signaled;
+			bool m_stop;
+			std::mutex m_mutex;
+			std::condition_variable m_wakeup;
+			std::thread m_thread;
+		};
+	}
+
+	/*
+		Background writer of the async sink. Producers push report records into a bounded lock-free queue and
+		return immediately; a background thread, started with the first record and woken whenever records arrive
+		while it sleeps, formats the records and writes them to stdout in batches.
+		At exit the thread is stopped and all buffered records are written; reports submitted after that are
+		written synchronously.
+	*/
+	class async_report_writer
+	{
+	public:
+		/**
+			* @brief Returns the process wide writer. The background thread starts with the first submitted record.
+		*/
+		static async_report_writer& instance();
+		/**
+			* @brief Buffers a record for writing. Never blocks.
+			* @param r	Record.
+		*/
+		void submit(const report_record& r) noexcept;
+		/**
+			* @brief Writes all records buffered so far and flushes stdout.
+		*/
+		void flush();
+		/**
+			* @brief Returns the number of reports lost to the overflow policy.
+		*/
+		std::uint64_t lost() const noexcept { return m_lost.load(std::memory_order_relaxed); }
+
+	private:
+		static constexpr std::size_t batch_size = 64;
+
+		async_report_writer();
+		// writes and flushes buffered records on the worker thread
+		static std::size_t write_batches(void* writer);
+		// writes buffered records, the write mutex must be held
+		std::size_t drain();
+		void shutdown();
+
+		detail::bounded_queue<report_record> m_queue;
+		std::atomic<std::uint64_t> m_lost;
+		std::atomic<bool> m_shut_down;
+		std::mutex m_write_mutex;
+		detail::wakeup_worker m_worker;
+	};
+
+	// reports through the async report writer; stopwatches with a make_report_record() member provide their own record
+	struct async_sink
+	{
+		template <typename stopwatch_type>
+		static void submit(const stopwatch_type& sw) noexcept
+		{
+			if constexpr (detail::has_report_record<stopwatch_type>::value)
+				async_report_writer::instance().submit(sw.make_report_record());
+			else
+				async_report_writer::instance().submit(report_record::make(sw.name(), sw.elapsed()));
+		}
+	};
+
+	// reports synchronously to std::cout via basic_stopwatch::report_elapsed()
+	struct ostream_sink
+	{
+		template <typename stopwatch_type>
+		static void submit(const stopwatch_type& sw)
+		{
+			sw.report_elapsed();
+		}
+	};
+
+	// discards all reports
+	struct null_sink
+	{
+		template <typename stopwatch_type>
+		static void submit(const stopwatch_type&) noexcept {}
+	};
+}
+
+// --- implementation ---
+
+template <typename duration_type>
+inline sw::report_record sw::report_record::make(std::string_view n, const duration_type& d) noexcept
+{
+	report_record r;
+	r.name_length = static_cast<std::uint8_t>(std::min(n.size(), max_name_length));
+	std::copy_n(n.data(), r.name_length, r.name);
+	r.integral = std::is_integral_v<typename duration_type::rep>;
+	if constexpr (std::is_integral_v<typename duration_type::rep>)
+		r.int_value = static_cast<std::int64_t>(d.count());
+	else
+		r.float_value = static_cast<double>(d.count());
+	r.unit = sw::time_unit_postfix<duration_type>::str();
+	r.field_count = 0;
+	return r;
+}
+
+template <typename value_type>
+inline void sw::report_record::add_count(const char* label, value_type v, const char* unit_postfix) noexcept
+{
+	if (field_count == max_fields)
+		return;
+	field& f = fields[field_count++];
+	f.label = label;
+	f.unit = unit_postfix;
+	f.integral = std::is_integral_v<value_type>;
+	if constexpr (std::is_integral_v<value_type>)
+		f.int_value = static_cast<std::int64_t>(v);
+	else
+		f.float_value = static_cast<double>(v);
+}
+
+template <typename duration_type>
+inline void sw::report_record::add_duration(const char* label, const duration_type& d) noexcept
+{
+	add_count(label, d.count(), sw::time_unit_postfix<duration_type>::str());
+}
+
+inline char* sw::report_record::format(char* first) const noexcept
+{
+	// writes a value and its optional unit into at most max_duration_str_length characters
+	const auto value = [](char* it, bool is_integral, std::int64_t i, double d, const char* postfix)
+	{
+		char* const last = it + max_duration_str_length;
+		it = is_integral ? sw::format_count(it, i) : sw::format_count(it, d);
+		if (postfix == nullptr)
+			return it;
+		if (it != last)
+			*it++ = ' ';
+		for (; *postfix != '\0' && it != last; ++postfix)
+			*it++ = *postfix;
+		return it;
+	};
+	char* it = std::copy_n(name, name_length, first);
+	it = value(it, integral, integral ? int_value : 0, integral ? 0.0 : float_value, unit);
+	for (std::size_t i = 0; i < field_count; ++i)
+	{
+		const field& f = fields[i];
+		*it++ = ',';
+		*it++ = ' ';
+		for (std::size_t n = 0; f.label[n] != '\0' && n < max_label_length; ++n)
+			*it++ = f.label[n];
+		*it++ = ' ';
+		it = value(it, f.integral, f.integral ? f.int_value : 0, f.integral ? 0.0 : f.float_value, f.unit);
+	}
+	*it++ = '\n';
+	return it;
+}
+
+template <typename value_type>
+inline sw::detail::bounded_queue<value_type>::bounded_queue(std::size_t capacity) :
+	m_cells(),
+	m_mask(0),
+	m_enqueue_pos(0),
+	m_dequeue_pos(0)
+{
+	std::size_t size = 2;
+	while (size < capacity)
+		size *= 2;
+	m_cells.reset(new cell[size]);
+	m_mask = size - 1;
+	for (std::size_t i = 0; i < size; ++i)
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template <typename value_type>
+inline bool sw::detail::bounded_queue<value_type>::try_push(const value_type& v) noexcept
+{
+	std::size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell& c = m_cells[pos & m_mask];
+		const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+		const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+		if (diff == 0)
+		{
+			if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				c.value = v;
+				c.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (diff < 0)
+			return false;
+		else
+			pos = m_enqueue_pos.load(std::memory_order_relaxed);
+	}
+}
+
+template <typename value_type>
+inline bool sw::detail::bounded_queue<value_type>::try_pop(value_type& v) noexcept
+{
+	std::size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		cell& c = m_cells[pos & m_mask];
+		const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+		const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+		if (diff == 0)
+		{
+			if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				v = c.value;
+				c.sequence.store(pos + m_mask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (diff < 0)
+			return false;
+		else
+			pos = m_dequeue_pos.load(std::memory_order_relaxed);
+	}
+}
+
+inline sw::detail::wakeup_worker::wakeup_worker(drain_fn drain, void* context) noexcept :
+	m_drain(drain),
+	m_context(context),
+	m_idle(true),
+	m_signaled(false),
+	m_stop(false),
+	m_mutex(),
+	m_wakeup(),
+	m_thread()
+{
+}
+
+inline void sw::detail::wakeup_worker::signal() noexcept
+{
+	// pairs with the exchange in run(): either the thread sees the work in its last drain or we see it idle
+	if (!m_idle.exchange(false, std::memory_order_acq_rel))
+		return;
+	try
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_stop)
+			return;
+		if (!m_thread.joinable())
+			m_thread = std::thread([this]() { run(); });
+		m_signaled = true;
+		m_wakeup.notify_one();
+	}
+	catch (...)
+	{
+		// no thread, let the next producer try again
+		m_idle.store(true, std::memory_order_relaxed);
+	}
+}
+
+inline void sw::detail::wakeup_worker::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_wakeup.notify_one();
+	}
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+inline void sw::detail::wakeup_worker::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_wakeup.wait(lock, [this]() { return m_signaled || m_stop; });
+		if (m_stop)
+			return;
+		m_signaled = false;
+		m_idle.store(false, std::memory_order_relaxed);
+		lock.unlock();
+		for (;;)
+		{
+			while (m_drain(m_context) != 0)
+				;
+			// announce idleness, then look once more for work pushed by producers that still saw us busy
+			m_idle.exchange(true, std::memory_order_acq_rel);
+			if (m_drain(m_context) == 0)
+				break;
+			m_idle.store(false, std::memory_order_relaxed);
+		}
+		lock.lock();
+	}
+}
+
+inline sw::async_report_writer& sw::async_report_writer::instance()
+{
+	// never destroyed, so that stopwatches in static destructors can still report
+	static async_report_writer* const writer = []()
+	{
+		async_report_writer* w = new async_report_writer();
+		std::atexit([]() { instance().shutdown(); });
+		return w;
+	}();
+	return *writer;
+}
+
+inline sw::async_report_writer::async_report_writer() :
+	m_queue(STOPWATCH_ASYNC_SINK_CAPACITY),
+	m_lost(0),
+	m_shut_down(false),
+	m_write_mutex(),
+	m_worker(&write_batches, this)
+{
+}
+
+inline void sw::async_report_writer::submit(const report_record& r) noexcept
+{
+	if (m_shut_down.load())
+	{
+		// background thread is gone, write synchronously
+		char buffer[report_record::max_formatted_length];
+		const char* const end = r.format(buffer);
+		std::lock_guard<std::mutex> lock(m_write_mutex);
+		std::fwrite(buffer, 1, static_cast<std::size_t>(end - buffer), stdout);
+		return;
+	}
+	bool pushed = m_queue.try_push(r);
+	if constexpr (STOPWATCH_ASYNC_SINK_OVERFLOW_POLICY == sink_overflow_policy::overwrite_oldest)
+	{
+		// the queue supports multiple consumers, so producers may discard the oldest record themselves
+		report_record oldest;
+		for (int attempt = 0; !pushed && attempt < 4; ++attempt)
+		{
+			if (m_queue.try_pop(oldest))
+				m_lost.fetch_add(1, std::memory_order_relaxed);
+			pushed = m_queue.try_push(r);
+		}
+	}
+	if (!pushed)
+	{
+		m_lost.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	// shutdown may have drained the queue between the check above and the push
+	if (m_shut_down.load())
+		flush();
+	else
+		m_worker.signal();
+}
+
+inline void sw::async_report_writer::flush()
+{
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+	drain();
+	std::fflush(stdout);
+}
+
+inline std::size_t sw::async_report_writer::write_batches(void* writer)
+{
+	async_report_writer& w = *static_cast<async_report_writer*>(writer);
+	std::lock_guard<std::mutex> lock(w.m_write_mutex);
+	const std::size_t written = w.drain();
+	if (written != 0)
+		std::fflush(stdout);
+	return written;
+}
+
+inline std::size_t sw::async_report_writer::drain()
+{
+	char buffer[batch_size * report_record::max_formatted_length];
+	std::size_t total = 0;
+	for (;;)
+	{
+		char* it = buffer;
+		std::size_t count = 0;
+		report_record r;
+		while (count < batch_size && m_queue.try_pop(r))
+		{
+			it = r.format(it);
+			++count;
+		}
+		if (count == 0)
+			return total;
+		std::fwrite(buffer, 1, static_cast<std::size_t>(it - buffer), stdout);
+		total += count;
+	}
+}
+
+inline void sw::async_report_writer::shutdown()
+{
+	m_worker.stop();
+	std::lock_guard<std::mutex> lock(m_write_mutex);
+	m_shut_down.store(true);
+	drain();
+	if (lost() != 0)
+		std::fprintf(stderr, "stopwatch: %llu reports lost due to a full async sink buffer\n", static_cast<unsigned long long>(lost()));
+	std::fflush(stdout);
+}
+
+#endif
@@ -3,15 +3,92 @@
 #include <iostream>
 #include <string_view>
 #include <string>
+#include <type_traits>
 #include <utility>
-#include <sstream>
 #include <stopwatch/common.hpp>
 #include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/sink.hpp>
+
+// Types whose code depends on stopwatch_enabled are declared in this inline namespace, so that their symbols differ
+// between translation units built with and without STOPWATCH_DISABLE, which can then be linked together.
+#if defined(STOPWATCH_DISABLE)
+	#define STOPWATCH_ABI_NAMESPACE disabled
+#else
+	#define STOPWATCH_ABI_NAMESPACE enabled
+#endif
 
 namespace sw
 {
+	namespace detail
+	{
+		// detects clocks that provide a bias to subtract from every measured interval, see bias_corrected_clock
+		template <typename clock_type, typename = void>
+		struct has_clock_bias : std::false_type {};
+		template <typename clock_type>
+		struct has_clock_bias<clock_type, std::void_t<decltype(clock_type::bias())>> : std::true_type {};
+	}
+
+#if defined(STOPWATCH_DISABLE)
+	inline constexpr bool stopwatch_enabled = false;
+
+	// STOPWATCH_DISABLE compiles stopwatches out: an empty type with the interface of basic_stopwatch that never reads
+	// a clock, measures zero and reports nothing. It lives in the disabled inline namespace, so that it does not clash
+	// with the enabled basic_stopwatch below.
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink = sw::async_sink>
+		class basic_stopwatch
+		{
+		public:
+			using clock_t = clock_type;
+			using clock_duration_t = typename clock_t::duration;
+			using clock_time_point_t = typename clock_t::time_point;
+			using report_duration_t = report_duration;
+			using report_sink_t = report_sink;
+
+			explicit basic_stopwatch(std::string_view = {}) noexcept {}
+			clock_time_point_t start() noexcept { return clock_time_point_t{}; }
+			clock_time_point_t resume() noexcept { return clock_time_point_t{}; }
+			clock_time_point_t stop() noexcept { return clock_time_point_t{}; }
+			void reset() noexcept {}
+			clock_duration_t elapsed_clock() const noexcept { return clock_duration_t::zero(); }
+			clock_time_point_t last_time_point() const noexcept { return clock_time_point_t{}; }
+			report_duration_t elapsed() const noexcept { return report_duration_t::zero(); }
+			template <typename duration_type>
+			duration_type elapsed_as() const noexcept { return duration_type::zero(); }
+			/// Returns an empty name, the name is not stored.
+			const std::string_view& name() const noexcept { return s_no_name; }
+			/// Returns an empty name that may be assigned to, assignments are discarded.
+			std::string_view& name() noexcept
+			{
+				static thread_local std::string_view discarded;
+				discarded = {};
+				return discarded;
+			}
+			template <typename ostrm, typename duration_type = report_duration_t>
+			void report_elapsed(ostrm&) const noexcept {}
+			template <typename duration_type = report_duration_t>
+			void report_elapsed() const noexcept {}
+			template <typename ostrm, typename duration_type = report_duration_t>
+			ostrm& print_elapsed(ostrm& s) const noexcept { return s; }
+			template <typename duration_type = report_duration_t>
+			std::ostream& print_elapsed() const noexcept { return std::cout; }
+			template <typename duration_type = report_duration_t>
+			std::string elapsed_str() const { return std::string(); }
+			inline friend std::ostream& operator<<(std::ostream& strm, const basic_stopwatch&) { return strm; }
+
+			inline static constexpr const char* unit_postfix = sw::time_unit_postfix<report_duration_t>::str();
+
+		private:
+			inline static constexpr std::string_view s_no_name{};
+		};
+	}
+#else
+	inline constexpr bool stopwatch_enabled = true;
+
 	// convenience raii class for stopping time
-	template <typename clock_type, typename report_duration, bool auto_start_on_construction , bool report_elapsed_at_destruction>
+	// report_sink receives the stopwatch on destruction if report_elapsed_at_destruction is true, see sink.hpp
+	template <typename clock_type, typename report_duration, bool auto_start_on_construction , bool report_elapsed_at_destruction, typename report_sink = sw::async_sink>
 	class basic_stopwatch
 	{
 	public:
@@ -19,6 +96,7 @@ namespace sw
 		using clock_duration_t = typename clock_t::duration;
 		using clock_time_point_t = typename clock_t::time_point;
 		using report_duration_t = report_duration;
+		using report_sink_t = report_sink;
 
 		/**
 			* @brief Creates a new basic_stopwatch with a name.
@@ -29,7 +107,7 @@ namespace sw
 		basic_stopwatch(const basic_stopwatch&) = default;
 		/// Copy assignment
 		basic_stopwatch& operator=(const basic_stopwatch&) = default;
-		/// Destructor. Reports passed time if report_elapsed_at_destruction is true.
+		/// Destructor. Stops the stopwatch and passes it to the report sink if report_elapsed_at_destruction is true.
 		~basic_stopwatch();
 		/**
 			* @brief Resets the elapsed time and starts the stopwatch.
@@ -56,6 +134,11 @@ namespace sw
 			* @return Elapsed time since last stop.
 		*/
 		clock_duration_t elapsed_clock() const;		
+		/**
+			* @brief Returns the time point of the last start, resume or stop.
+			* @return Time point of the last clock reading.
+		*/
+		clock_time_point_t last_time_point() const;
 		/**
 			* @brief Returns the elapsed time since the last stop, duration_cast'ed into the given duration type.
 			* @tparam duration_type	Desired duration type.
@@ -121,12 +204,11 @@ namespace sw
 		inline static constexpr const char* unit_postfix = sw::time_unit_postfix<report_duration_t>::str();
 
 	private:
-		mutable std::stringstream m_sstrm;
 		std::string_view m_name;	
 		clock_time_point_t m_t0;
 		clock_duration_t m_elapsed;
-		
 	};
+#endif
 
 	using hres_stopwatch_scoped_h 	= basic_stopwatch<std::chrono::high_resolution_clock, hours_d, true, true>;
 	using hres_stopwatch_auto_h 	= basic_stopwatch<std::chrono::high_resolution_clock, sw::hours_d, true, false>;
@@ -184,115 +266,156 @@ namespace sw
 	using cpu_scoped_stopwatch_ns 	= basic_stopwatch<cpu_clock, sw::nanoseconds_d, true, true>;
 	using cpu_auto_stopwatch_ns 	= basic_stopwatch<cpu_clock, sw::nanoseconds_d, true, false>;
 	using cpu_stopwatch_ns 			= basic_stopwatch<cpu_clock, sw::nanoseconds_d, false, false>;
+
+	using tsc_stopwatch_scoped_h 	= basic_stopwatch<tsc_clock, hours_d, true, true>;
+	using tsc_stopwatch_auto_h 		= basic_stopwatch<tsc_clock, sw::hours_d, true, false>;
+	using tsc_stopwatch_h 			= basic_stopwatch<tsc_clock, sw::hours_d, false, false>;
+	using tsc_scoped_stopwatch_m 	= basic_stopwatch<tsc_clock, sw::minutes_d, true, true>;
+	using tsc_auto_stopwatch_m 		= basic_stopwatch<tsc_clock, sw::minutes_d, true, false>;
+	using tsc_stopwatch_m 			= basic_stopwatch<tsc_clock, sw::minutes_d, false, false>;
+	using tsc_scoped_stopwatch_s 	= basic_stopwatch<tsc_clock, sw::seconds_d, true, true>;
+	using tsc_auto_stopwatch_s 		= basic_stopwatch<tsc_clock, sw::seconds_d, true, false>;
+	using tsc_stopwatch_s 			= basic_stopwatch<tsc_clock, sw::seconds_d, false, false>;
+	using tsc_scoped_stopwatch_ms 	= basic_stopwatch<tsc_clock, sw::milliseconds_d, true, true>;
+	using tsc_auto_stopwatch_ms 	= basic_stopwatch<tsc_clock, sw::milliseconds_d, true, false>;
+	using tsc_stopwatch_ms 			= basic_stopwatch<tsc_clock, sw::milliseconds_d, false, false>;
+	using tsc_scoped_stopwatch_us 	= basic_stopwatch<tsc_clock, sw::microseconds_d, true, true>;
+	using tsc_auto_stopwatch_us 	= basic_stopwatch<tsc_clock, sw::microseconds_d, true, false>;
+	using tsc_stopwatch_us 			= basic_stopwatch<tsc_clock, sw::microseconds_d, false, false>;
+	using tsc_scoped_stopwatch_ns 	= basic_stopwatch<tsc_clock, sw::nanoseconds_d, true, true>;
+	using tsc_auto_stopwatch_ns 	= basic_stopwatch<tsc_clock, sw::nanoseconds_d, true, false>;
+	using tsc_stopwatch_ns 			= basic_stopwatch<tsc_clock, sw::nanoseconds_d, false, false>;
 }
 
 // --- implementation ---
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::basic_stopwatch(std::string_view name) :
-	m_sstrm(),
+#if !defined(STOPWATCH_DISABLE)
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::basic_stopwatch(std::string_view name) :
 	m_name(name),
-	m_elapsed(clock_duration_t::zero()),
-	m_t0()
+	m_t0(),
+	m_elapsed(clock_duration_t::zero())
 {
 	if constexpr (auto_start_on_construction)
 		m_t0 = clock_t::now();
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::~basic_stopwatch()
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::~basic_stopwatch()
 {
 	if constexpr (report_elapsed_at_destruction)
 	{
 		stop();
-		report_elapsed();
+		report_sink::submit(*this);
 	}
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::start()
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::start()
 {
 	reset();
 	m_t0 = clock_t::now();
 	return m_t0;
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::resume()
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::resume()
 {
 	m_t0 = clock_t::now();
 	return m_t0;
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::stop()
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::stop()
 {
 	const clock_time_point_t t1 = clock_t::now();
-	m_elapsed += t1 - m_t0;
+	if constexpr (detail::has_clock_bias<clock_t>::value)
+	{
+		const clock_duration_t interval = t1 - m_t0 - clock_t::bias();
+		m_elapsed += interval > clock_duration_t::zero() ? interval : clock_duration_t::zero();
+	}
+	else
+		m_elapsed += t1 - m_t0;
 	m_t0 = t1;
 	return t1;
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline void sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::reset()
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline void sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::reset()
 {
 	m_elapsed = clock_duration_t::zero();
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::clock_duration_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::elapsed_clock() const
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_duration_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::elapsed_clock() const
 {
 	return m_elapsed;
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
-inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::report_duration_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::elapsed() const
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::last_time_point() const
+{
+	return m_t0;
+}
+
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_duration_t sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::elapsed() const
 {
 	return elapsed_as<report_duration_t>();
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
 template<typename duration_type>
-inline duration_type sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::elapsed_as() const
+inline duration_type sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::elapsed_as() const
 {
 	return as<duration_type>(m_elapsed);
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
 template<typename ostrm, typename duration_type>
-inline void sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::report_elapsed(ostrm& s) const
+inline void sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_elapsed(ostrm& s) const
 {
-	s << m_name << elapsed_as<duration_type>().count() << " " << sw::time_unit_postfix<duration_type>::str() << std::endl;
+	char buffer[sw::max_duration_str_length];
+	const char* const end = sw::format_duration(buffer, elapsed_as<duration_type>());
+	s << m_name << std::string_view(buffer, static_cast<std::size_t>(end - buffer)) << std::endl;
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
 template<typename duration_type>
-inline void sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::report_elapsed() const
+inline void sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_elapsed() const
 {
 	report_elapsed(std::cout);
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
 template<typename ostrm, typename duration_type>
-inline decltype(auto) sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::print_elapsed(ostrm& s) const
+inline decltype(auto) sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::print_elapsed(ostrm& s) const
 {
-	return s << elapsed_as<duration_type>().count() << " " << sw::time_unit_postfix<duration_type>::str();
+	char buffer[sw::max_duration_str_length];
+	const char* const end = sw::format_duration(buffer, elapsed_as<duration_type>());
+	return s << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
 template<typename duration_type>
-inline decltype(auto) sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::print_elapsed() const
+inline decltype(auto) sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::print_elapsed() const
 {
 	return print_elapsed(std::cout);
 }
 
-template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction>
+template<typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
 template<typename duration_type>
-inline std::string sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction>::elapsed_str() const
+inline std::string sw::basic_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::elapsed_str() const
 {
-	m_sstrm.clear();
-	m_sstrm << m_name << elapsed_as<duration_type>().count() << " " << sw::time_unit_postfix<duration_type>::str();
-	return m_sstrm.str();
+	char buffer[sw::max_duration_str_length];
+	const char* const end = sw::format_duration(buffer, elapsed_as<duration_type>());
+	std::string str;
+	str.reserve(m_name.size() + static_cast<std::size_t>(end - buffer));
+	str.append(m_name).append(buffer, static_cast<std::size_t>(end - buffer));
+	return str;
 }
 
-#endif
\ No newline at end of file
+#endif
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef _STOPWATCH_TASK_STOPWATCH_HPP_
+#define _STOPWATCH_TASK_STOPWATCH_HPP_
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/sink.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+namespace sw
+{
+	// what a task stopwatch is currently accumulating
+	enum class task_state
+	{
+		stopped,
+		active,
+		suspended
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		/*
+			Stopwatch for tasks that suspend, e.g. coroutines, fibers or callback chains. Time between suspend() and resume()
+			is accumulated as suspended time instead of active time, and every suspension is counted. The stopwatch keeps no
+			per-thread state, so a task may suspend on one thread and resume on another, as long as the hand-over orders the
+			calls, which every executor does. Use a wall clock; thread cpu clocks can not be compared across threads.
+			stopwatch/task_stopwatch_coro.hpp suspends and resumes it automatically at every co_await of a C++20 coroutine.
+		*/
+		// report_sink receives the stopwatch on destruction if report_elapsed_at_destruction is true, see sink.hpp
+		template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink = sw::async_sink>
+		class basic_task_stopwatch
+		{
+			static_assert(!std::is_same_v<clock_type, thread_cpu_clock>, "thread cpu time of a task that migrates between threads is meaningless");
+
+		public:
+			using clock_t = clock_type;
+			using clock_duration_t = typename clock_t::duration;
+			using clock_time_point_t = typename clock_t::time_point;
+			using report_duration_t = report_duration;
+			using report_sink_t = report_sink;
+
+			/**
+				* @brief Creates a new basic_task_stopwatch with a name.
+				* @param name	Name of the stopwatch.
+			*/
+			explicit basic_task_stopwatch(std::string_view name = {});
+			/// Destructor. Stops the stopwatch and hands it to report_sink if report_elapsed_at_destruction is true.
+			~basic_task_stopwatch();
+			/**
+				* @brief Resets all accumulators and starts accumulating active time.
+				* @return Time point of stopwatch start.
+			*/
+			clock_time_point_t start();
+			/**
+				* @brief Ends the active interval and starts accumulating suspended time. Does nothing unless active.
+				* @return Time point of suspension.
+			*/
+			clock_time_point_t suspend();
+			/**
+				* @brief Ends the suspended interval, or leaves the stopped state without resetting, and accumulates active time again.
+				*		 Does nothing if already active.
+				* @return Time point of resumption.
+			*/
+			clock_time_point_t resume();
+			/**
+				* @brief Ends the current active or suspended interval.
+				* @return Time point of stopwatch stop.
+			*/
+			clock_time_point_t stop();
+			/**
+				* @brief Resets all accumulators without changing the state.
+			*/
+			void reset();
+			/**
+				* @brief Returns what the stopwatch currently accumulates.
+			*/
+			task_state state() const noexcept { return m_state; }
+			/**
+				* @brief Returns the active time up to the last state change in clock duration.
+			*/
+			clock_duration_t active_clock() const noexcept { return m_active; }
+			/**
+				* @brief Returns the suspended time up to the last state change in clock duration.
+			*/
+			clock_duration_t suspended_clock() const noexcept { return m_suspended; }
+			/**
+				* @brief Returns the active time up to the last state change, converted into the given duration type.
+			*/
+			template <typename duration_type = report_duration_t>
+			duration_type active() const { return as<duration_type>(m_active); }
+			/**
+				* @brief Returns the suspended time up to the last state change, converted into the given duration type.
+			*/
+			template <typename duration_type = report_duration_t>
+			duration_type suspended() const { return as<duration_type>(m_suspended); }
+			/**
+				* @brief Returns the number of suspensions since the last start or reset.
+			*/
+			std::uint64_t suspensions() const noexcept { return m_suspensions; }
+			/**
+				* @brief Returns the name of the stopwatch.
+			*/
+			std::string_view name() const noexcept { return m_name; }
+			/**
+				* @brief Prints active time, suspended time and suspensions on a single line.
+				* @tparam duration_type	Duration type for printing times.
+			*/
+			template <typename ostrm, typename duration_type = report_duration_t>
+			void report_elapsed(ostrm& s) const;
+			/**
+				* @brief Prints active time, suspended time and suspensions to std::cout.
+			*/
+			template <typename duration_type = report_duration_t>
+			void report_elapsed() const;
+			/**
+				* @brief Returns name, active time, suspended time and suspensions as a record for the async sink.
+			*/
+			report_record make_report_record() const noexcept;
+
+		private:
+			// adds the interval since the last state change to the accumulator of the current state
+			clock_time_point_t transition(task_state next);
+
+			std::string_view m_name;
+			clock_time_point_t m_t0;
+			clock_duration_t m_active;
+			clock_duration_t m_suspended;
+			std::uint64_t m_suspensions;
+			task_state m_state;
+		};
+	}
+
+	using hres_task_stopwatch_ms 		= basic_task_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, false, false>;
+	using hres_task_stopwatch_us 		= basic_task_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, false, false>;
+	using hres_task_stopwatch_ns 		= basic_task_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, false, false>;
+	using hres_auto_task_stopwatch_ms 	= basic_task_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, true, false>;
+	using hres_auto_task_stopwatch_us 	= basic_task_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, true, false>;
+	using hres_auto_task_stopwatch_ns 	= basic_task_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, true, false>;
+	using hres_scoped_task_stopwatch_ms = basic_task_stopwatch<std::chrono::high_resolution_clock, sw::milliseconds_d, true, true>;
+	using hres_scoped_task_stopwatch_us = basic_task_stopwatch<std::chrono::high_resolution_clock, sw::microseconds_d, true, true>;
+	using hres_scoped_task_stopwatch_ns = basic_task_stopwatch<std::chrono::high_resolution_clock, sw::nanoseconds_d, true, true>;
+
+	using steady_task_stopwatch_ms 			= basic_task_stopwatch<std::chrono::steady_clock, sw::milliseconds_d, false, false>;
+	using steady_task_stopwatch_us 			= basic_task_stopwatch<std::chrono::steady_clock, sw::microseconds_d, false, false>;
+	using steady_task_stopwatch_ns 			= basic_task_stopwatch<std::chrono::steady_clock, sw::nanoseconds_d, false, false>;
+	using steady_auto_task_stopwatch_ms 	= basic_task_stopwatch<std::chrono::steady_clock, sw::milliseconds_d, true, false>;
+	using steady_auto_task_stopwatch_us 	= basic_task_stopwatch<std::chrono::steady_clock, sw::microseconds_d, true, false>;
+	using steady_auto_task_stopwatch_ns 	= basic_task_stopwatch<std::chrono::steady_clock, sw::nanoseconds_d, true, false>;
+	using steady_scoped_task_stopwatch_ms 	= basic_task_stopwatch<std::chrono::steady_clock, sw::milliseconds_d, true, true>;
+	using steady_scoped_task_stopwatch_us 	= basic_task_stopwatch<std::chrono::steady_clock, sw::microseconds_d, true, true>;
+	using steady_scoped_task_stopwatch_ns 	= basic_task_stopwatch<std::chrono::steady_clock, sw::nanoseconds_d, true, true>;
+
+	using tsc_task_stopwatch_ms 		= basic_task_stopwatch<tsc_clock, sw::milliseconds_d, false, false>;
+	using tsc_task_stopwatch_us 		= basic_task_stopwatch<tsc_clock, sw::microseconds_d, false, false>;
+	using tsc_task_stopwatch_ns 		= basic_task_stopwatch<tsc_clock, sw::nanoseconds_d, false, false>;
+	using tsc_auto_task_stopwatch_ms 	= basic_task_stopwatch<tsc_clock, sw::milliseconds_d, true, false>;
+	using tsc_auto_task_stopwatch_us 	= basic_task_stopwatch<tsc_clock, sw::microseconds_d, true, false>;
+	using tsc_auto_task_stopwatch_ns 	= basic_task_stopwatch<tsc_clock, sw::nanoseconds_d, true, false>;
+	using tsc_scoped_task_stopwatch_ms 	= basic_task_stopwatch<tsc_clock, sw::milliseconds_d, true, true>;
+	using tsc_scoped_task_stopwatch_us 	= basic_task_stopwatch<tsc_clock, sw::microseconds_d, true, true>;
+	using tsc_scoped_task_stopwatch_ns 	= basic_task_stopwatch<tsc_clock, sw::nanoseconds_d, true, true>;
+}
+
+// --- implementation ---
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::basic_task_stopwatch(std::string_view name) :
+	m_name(name),
+	m_t0(),
+	m_active(clock_duration_t::zero()),
+	m_suspended(clock_duration_t::zero()),
+	m_suspensions(0),
+	m_state(task_state::stopped)
+{
+	if constexpr (auto_start_on_construction)
+		start();
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::~basic_task_stopwatch()
+{
+	if constexpr (report_elapsed_at_destruction && stopwatch_enabled)
+	{
+		stop();
+		report_sink::submit(*this);
+	}
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::start()
+{
+	reset();
+	m_state = task_state::active;
+	if constexpr (stopwatch_enabled)
+		m_t0 = clock_t::now();
+	return m_t0;
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::suspend()
+{
+	if (m_state != task_state::active)
+		return m_t0;
+	++m_suspensions;
+	return transition(task_state::suspended);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::resume()
+{
+	if (m_state == task_state::active)
+		return m_t0;
+	return transition(task_state::active);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::stop()
+{
+	return transition(task_state::stopped);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline void sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::reset()
+{
+	m_active = clock_duration_t::zero();
+	m_suspended = clock_duration_t::zero();
+	m_suspensions = 0;
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+template <typename ostrm, typename duration_type>
+inline void sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_elapsed(ostrm& s) const
+{
+	if constexpr (stopwatch_enabled)
+	{
+		char buffer[sw::max_duration_str_length];
+		const auto field = [&](const char* label, const duration_type& d)
+		{
+			const char* const end = sw::format_duration(buffer, d);
+			s << label << std::string_view(buffer, static_cast<std::size_t>(end - buffer));
+		};
+		s << m_name;
+		field("active ", active<duration_type>());
+		field(", suspended ", suspended<duration_type>());
+		s << ", suspensions " << m_suspensions << std::endl;
+	}
+	else
+		static_cast<void>(s);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+template <typename duration_type>
+inline void sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::report_elapsed() const
+{
+	report_elapsed<std::ostream, duration_type>(std::cout);
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline typename sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::clock_time_point_t sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::transition(task_state next)
+{
+	if constexpr (stopwatch_enabled)
+	{
+		const clock_time_point_t t1 = clock_t::now();
+		if (m_state == task_state::active)
+			m_active += t1 - m_t0;
+		else if (m_state == task_state::suspended)
+			m_suspended += t1 - m_t0;
+		m_t0 = t1;
+	}
+	m_state = next;
+	return m_t0;
+}
+
+template <typename clock_type, typename report_duration, bool auto_start_on_construction, bool report_elapsed_at_destruction, typename report_sink>
+inline sw::report_record sw::basic_task_stopwatch<clock_type, report_duration, auto_start_on_construction, report_elapsed_at_destruction, report_sink>::make_report_record() const noexcept
+{
+	report_record r = report_record::make(m_name, active());
+	r.add_duration("suspended", suspended());
+	r.add_count("suspensions", m_suspensions);
+	return r;
+}
+
+#endif
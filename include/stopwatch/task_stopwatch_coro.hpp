@@ -0,0 +1,152 @@
+#ifndef _STOPWATCH_TASK_STOPWATCH_CORO_HPP_
+#define _STOPWATCH_TASK_STOPWATCH_CORO_HPP_
+#include <stopwatch/task_stopwatch.hpp>
+
+// coroutine support needs C++20, the header is empty otherwise
+#if !defined(STOPWATCH_HAS_COROUTINES)
+	#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+		#define STOPWATCH_HAS_COROUTINES 1
+	#else
+		#define STOPWATCH_HAS_COROUTINES 0
+	#endif
+#endif
+
+#if STOPWATCH_HAS_COROUTINES
+#include <coroutine>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace sw
+{
+	namespace detail
+	{
+		// obtains the awaiter of an awaitable like co_await does: member operator co_await, free operator co_await or the awaitable itself
+		template <typename awaitable_type>
+		decltype(auto) get_awaiter(awaitable_type&& a)
+		{
+			if constexpr (requires { std::forward<awaitable_type>(a).operator co_await(); })
+				return std::forward<awaitable_type>(a).operator co_await();
+			else if constexpr (requires { operator co_await(std::forward<awaitable_type>(a)); })
+				return operator co_await(std::forward<awaitable_type>(a));
+			else
+				return std::forward<awaitable_type>(a);
+		}
+
+		// lvalue awaiters are referenced, temporaries are moved into the wrapping awaiter
+		template <typename awaitable_type>
+		using awaiter_t = std::conditional_t<std::is_lvalue_reference_v<decltype(get_awaiter(std::declval<awaitable_type>()))>,
+											 decltype(get_awaiter(std::declval<awaitable_type>())),
+											 std::remove_cvref_t<decltype(get_awaiter(std::declval<awaitable_type>()))>>;
+	}
+
+	/*
+		Awaiter suspending a task stopwatch while the awaiting coroutine is suspended. The stopwatch is suspended before
+		the inner await_suspend runs, because the coroutine may be resumed on another thread before that call returns,
+		and resumed in await_resume. An await_suspend returning false still counts as a suspension.
+	*/
+	template <typename stopwatch_type, typename awaiter_type>
+	class timed_awaiter
+	{
+	public:
+		template <typename awaitable_type>
+		timed_awaiter(stopwatch_type& s, awaitable_type&& a) : m_stopwatch(s), m_awaiter(detail::get_awaiter(std::forward<awaitable_type>(a))) {}
+
+		bool await_ready() { return m_awaiter.await_ready(); }
+
+		template <typename promise_type>
+		decltype(auto) await_suspend(std::coroutine_handle<promise_type> h)
+		{
+			m_stopwatch.suspend();
+			return m_awaiter.await_suspend(h);
+		}
+
+		decltype(auto) await_resume()
+		{
+			m_stopwatch.resume();
+			return m_awaiter.await_resume();
+		}
+
+	private:
+		stopwatch_type& m_stopwatch;
+		awaiter_type m_awaiter;
+	};
+
+	/**
+		* @brief Wraps an awaitable so that co_await'ing it pauses the stopwatch while the coroutine is suspended.
+		* @param s	Task stopwatch of the awaiting coroutine.
+		* @param a	Awaitable, referenced by the returned awaiter if it is an lvalue awaiter, moved into it otherwise.
+		* @return	Awaiter to co_await.
+	*/
+	template <typename stopwatch_type, typename awaitable_type>
+	timed_awaiter<stopwatch_type, detail::awaiter_t<awaitable_type>> timed(stopwatch_type& s, awaitable_type&& a)
+	{
+		return timed_awaiter<stopwatch_type, detail::awaiter_t<awaitable_type>>(s, std::forward<awaitable_type>(a));
+	}
+
+	/*
+		Mixin for promise types that times the coroutine with a task stopwatch. await_transform wraps every co_await
+		in a timed_awaiter. initial_suspend starts the stopwatch when the body starts running, after the first resume
+		of a lazy coroutine, and final_suspend stops it. A promise that defines its own final_suspend should call
+		stop_timing() in it; one that defines its own await_transform replaces this one.
+		Example: struct promise_type : sw::timed_promise<sw::steady_scoped_task_stopwatch_us> { ... };
+	*/
+	template <typename stopwatch_type, bool lazy_start = true>
+	class timed_promise
+	{
+	public:
+		timed_promise() : m_stopwatch() {}
+		/**
+			* @brief Names the stopwatch, e.g. from the constructor of the derived promise type.
+			* @param name	Name of the stopwatch.
+		*/
+		explicit timed_promise(std::string_view name) : m_stopwatch(name) {}
+
+		struct initial_awaiter
+		{
+			stopwatch_type& stopwatch;
+
+			bool await_ready() const noexcept { return !lazy_start; }
+			void await_suspend(std::coroutine_handle<>) const noexcept {}
+			void await_resume() const { stopwatch.start(); }
+		};
+
+		struct final_awaiter
+		{
+			stopwatch_type& stopwatch;
+
+			bool await_ready() const noexcept
+			{
+				stopwatch.stop();
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<>) const noexcept {}
+			void await_resume() const noexcept {}
+		};
+
+		/**
+			* @brief Returns the stopwatch timing the coroutine.
+		*/
+		stopwatch_type& task_stopwatch() noexcept { return m_stopwatch; }
+		const stopwatch_type& task_stopwatch() const noexcept { return m_stopwatch; }
+		/**
+			* @brief Stops the stopwatch, for promises with their own final_suspend.
+		*/
+		void stop_timing() { m_stopwatch.stop(); }
+
+		initial_awaiter initial_suspend() noexcept { return initial_awaiter{m_stopwatch}; }
+		final_awaiter final_suspend() noexcept { return final_awaiter{m_stopwatch}; }
+
+		template <typename awaitable_type>
+		timed_awaiter<stopwatch_type, detail::awaiter_t<awaitable_type>> await_transform(awaitable_type&& a)
+		{
+			return timed(m_stopwatch, std::forward<awaitable_type>(a));
+		}
+
+	private:
+		stopwatch_type m_stopwatch;
+	};
+}
+#endif
+
+#endif
@@ -0,0 +1,458 @@
+#ifndef _STOPWATCH_TRACE_HPP_
+#define _STOPWATCH_TRACE_HPP_
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+// number of events buffered per thread and session, further events are dropped
+#if !defined(STOPWATCH_TRACE_EVENTS_PER_THREAD)
+	#define STOPWATCH_TRACE_EVENTS_PER_THREAD 65536
+#endif
+
+namespace sw
+{
+	// complete ("X") event of a timed section
+	struct trace_event
+	{
+		std::string_view name;
+		std::int64_t begin_ns;		// begin in nanoseconds since the clock's epoch
+		std::int64_t duration_ns;
+	};
+
+	/*
+		Process wide trace recorder. Every thread records into its own fixed capacity buffer, which is
+		allocated with the first event of the thread (or by prepare_thread()) and reused by later sessions.
+		Recording is a relaxed flag check and an append, events beyond the capacity are counted and dropped.
+		Event names are stored as string views and must stay valid until the trace is written.
+		The buffer of an exited thread keeps its events until the next start(), which hands it to the next new
+		thread, so memory grows with the number of concurrently recording threads, not with all threads ever seen.
+		start() only bumps the session generation; each thread discards its old events with its first record of
+		the new session, so threads still recording while start() runs never mix events of two sessions.
+
+		write_binary() emits the following layout in native byte order:
+			char[8]  "SWTRACE1"
+			uint32   name count, then per name: uint32 length, char[length]
+			uint32   thread count, then per thread:
+			             uint32 thread id, uint32 thread name index (0xffffffff if unnamed),
+			             uint64 dropped events, uint32 event count,
+			             per event: uint32 name index, int64 begin ns, int64 duration ns
+	*/
+	class trace_session
+	{
+	public:
+		static constexpr std::size_t events_per_thread = STOPWATCH_TRACE_EVENTS_PER_THREAD;
+
+		/**
+			* @brief Returns the process wide trace session. It is never destroyed.
+		*/
+		static trace_session& instance();
+		/**
+			* @brief Discards all buffered events and starts recording.
+		*/
+		void start();
+		/**
+			* @brief Stops recording. Buffered events are kept until the next start().
+		*/
+		void stop() noexcept { m_active.store(false, std::memory_order_relaxed); }
+		/// Returns whether events are currently recorded.
+		bool active() const noexcept { return m_active.load(std::memory_order_relaxed); }
+		/**
+			* @brief Records an event into the calling thread's buffer if the session is active.
+			* @param name			Event name, must stay valid until the trace is written.
+			* @param begin_ns		Begin of the event in nanoseconds.
+			* @param duration_ns	Duration of the event in nanoseconds.
+		*/
+		void record(std::string_view name, std::int64_t begin_ns, std::int64_t duration_ns) noexcept;
+		/**
+			* @brief Allocates the calling thread's event buffer, so that the first recorded event does not.
+		*/
+		void prepare_thread();
+		/**
+			* @brief Names the calling thread in the written trace.
+			* @param name	Thread name, copied.
+		*/
+		void set_thread_name(std::string_view name);
+		/// Returns the number of buffered events of all threads.
+		std::size_t event_count() const;
+		/// Returns the number of events dropped because a thread's buffer was full.
+		std::uint64_t dropped() const;
+		/**
+			* @brief Writes all buffered events in Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+			*		 Timestamps are relative to the earliest event.
+		*/
+		template <typename ostrm>
+		void write_chrome_json(ostrm& s) const;
+		/**
+			* @brief Writes all buffered events in the compact binary format described above.
+		*/
+		template <typename ostrm>
+		void write_binary(ostrm& s) const;
+
+	private:
+		enum class buffer_owner
+		{
+			thread,		// recording thread is alive
+			exited,		// events are kept until the next start()
+			none		// free for the next new thread, not written
+		};
+		struct thread_buffer
+		{
+			std::uint32_t id = 0;
+			std::string name;
+			buffer_owner owner = buffer_owner::thread;
+			std::unique_ptr<trace_event[]> events;
+			std::atomic<std::uint64_t> state{0};	// session generation in the high, event count in the low 32 bits
+			std::atomic<std::uint64_t> dropped{0};
+		};
+		// buffer of the calling thread; trivially destructible, so it stays valid until the thread is gone
+		struct thread_state
+		{
+			thread_buffer* buffer = nullptr;
+			bool detached = false;	// set once the thread exited
+		};
+		// releases the calling thread's buffer at thread exit
+		struct thread_guard
+		{
+			~thread_guard();
+		};
+
+		trace_session() = default;
+		static thread_state& local_state() noexcept;
+		// returns nullptr once the calling thread's buffer was released
+		thread_buffer* local_buffer();
+		thread_buffer* attach_thread();
+		void detach_thread(thread_buffer* b);
+		// number of events of the current session, the mutex must be held
+		std::size_t session_count(const thread_buffer& b) const noexcept;
+		static void write_microseconds(std::string& out, std::int64_t ns);
+
+		std::atomic<bool> m_active{false};
+		std::atomic<std::uint32_t> m_generation{0};
+		mutable std::mutex m_mutex;
+		std::vector<std::unique_ptr<thread_buffer>> m_buffers;
+		std::uint32_t m_next_id = 1;
+	};
+
+	// Records stopped stopwatches as trace events, for use as basic_stopwatch's report sink. The event ends at the
+	// last stop and spans the elapsed time, which is only right for one uninterrupted interval since the last
+	// start: do not resume stopwatches reporting here, the trace stopwatch types below reject resume().
+	struct trace_sink
+	{
+		template <typename stopwatch_type>
+		static void submit(const stopwatch_type& sw) noexcept
+		{
+			trace_session& session = trace_session::instance();
+			if (!session.active())
+				return;
+			const std::int64_t end_ns = as<std::chrono::nanoseconds>(sw.last_time_point().time_since_epoch()).count();
+			const std::int64_t duration_ns = as<std::chrono::nanoseconds>(sw.elapsed_clock()).count();
+			session.record(sw.name(), end_ns - duration_ns, duration_ns);
+		}
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		// scoped stopwatch recording one trace event per start, resuming would make the event overlap the gap
+		template <typename clock_type>
+		class basic_trace_stopwatch : public basic_stopwatch<clock_type, sw::nanoseconds_d, true, true, trace_sink>
+		{
+		public:
+			using base_t = basic_stopwatch<clock_type, sw::nanoseconds_d, true, true, trace_sink>;
+			using typename base_t::clock_time_point_t;
+
+			using base_t::base_t;
+			clock_time_point_t resume() = delete;
+		};
+	}
+
+	using hres_trace_stopwatch 	= basic_trace_stopwatch<std::chrono::high_resolution_clock>;
+	using sys_trace_stopwatch 	= basic_trace_stopwatch<std::chrono::system_clock>;
+	using cpu_trace_stopwatch 	= basic_trace_stopwatch<cpu_clock>;
+	using tsc_trace_stopwatch 	= basic_trace_stopwatch<tsc_clock>;
+}
+
+// --- implementation ---
+
+inline sw::trace_session& sw::trace_session::instance()
+{
+	static trace_session* const session = new trace_session();
+	return *session;
+}
+
+inline void sw::trace_session::start()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// events of exited threads belong to the previous session, their buffers are free now
+	for (const std::unique_ptr<thread_buffer>& b : m_buffers)
+	{
+		if (b->owner == buffer_owner::exited)
+			b->owner = buffer_owner::none;
+	}
+	m_generation.fetch_add(1, std::memory_order_release);
+	m_active.store(true, std::memory_order_release);
+}
+
+inline void sw::trace_session::record(std::string_view name, std::int64_t begin_ns, std::int64_t duration_ns) noexcept
+{
+	if (!active())
+		return;
+	thread_buffer* const b = local_buffer();
+	if (b == nullptr)
+		return;
+	// only the owning thread appends, the release store publishes the event to the trace writers
+	const std::uint64_t generation = m_generation.load(std::memory_order_acquire);
+	const std::uint64_t state = b->state.load(std::memory_order_relaxed);
+	std::size_t n = static_cast<std::size_t>(state & 0xffffffffu);
+	if ((state >> 32) != generation)
+	{
+		// first event of a new session, discard the previous one
+		n = 0;
+		b->dropped.store(0, std::memory_order_relaxed);
+	}
+	if (n < events_per_thread)
+	{
+		b->events[n] = trace_event{name, begin_ns, duration_ns};
+		b->state.store(generation << 32 | (n + 1), std::memory_order_release);
+	}
+	else
+		b->dropped.store(b->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+inline void sw::trace_session::prepare_thread()
+{
+	local_buffer();
+}
+
+inline void sw::trace_session::set_thread_name(std::string_view name)
+{
+	thread_buffer* const b = local_buffer();
+	if (b == nullptr)
+		return;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	b->name.assign(name);
+}
+
+inline std::size_t sw::trace_session::event_count() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::size_t count = 0;
+	for (const std::unique_ptr<thread_buffer>& b : m_buffers)
+		count += session_count(*b);
+	return count;
+}
+
+inline std::uint64_t sw::trace_session::dropped() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::uint64_t count = 0;
+	for (const std::unique_ptr<thread_buffer>& b : m_buffers)
+	{
+		if (session_count(*b) != 0)
+			count += b->dropped.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+template <typename ostrm>
+inline void sw::trace_session::write_chrome_json(ostrm& s) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::int64_t base_ns = INT64_MAX;
+	for (const std::unique_ptr<thread_buffer>& b : m_buffers)
+	{
+		const std::size_t count = session_count(*b);
+		for (std::size_t i = 0; i < count; ++i)
+			base_ns = std::min(base_ns, b->events[i].begin_ns);
+	}
+	std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (const std::unique_ptr<thread_buffer>& b : m_buffers)
+	{
+		if (b->owner == buffer_owner::none)
+			continue;
+		const std::string tid = std::to_string(b->id);
+		if (!b->name.empty())
+		{
+			out += first ? "\n" : ",\n";
+			first = false;
+			out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":";
+			detail::append_json_string(out, b->name);
+			out += "}}";
+		}
+		const std::size_t count = session_count(*b);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const trace_event& e = b->events[i];
+			out += first ? "\n" : ",\n";
+			first = false;
+			out += "{\"name\":";
+			detail::append_json_string(out, e.name);
+			out += ",\"ph\":\"X\",\"pid\":1,\"tid\":" + tid + ",\"ts\":";
+			write_microseconds(out, e.begin_ns - base_ns);
+			out += ",\"dur\":";
+			write_microseconds(out, e.duration_ns);
+			out += '}';
+		}
+		// flush per thread to bound the size of the intermediate string
+		s.write(out.data(), static_cast<std::streamsize>(out.size()));
+		out.clear();
+	}
+	out += "\n]}\n";
+	s.write(out.data(), static_cast<std::streamsize>(out.size()));
+	s.flush();
+}
+
+template <typename ostrm>
+inline void sw::trace_session::write_binary(ostrm& s) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const auto write_u32 = [&s](std::uint32_t v) { s.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+	const auto write_u64 = [&s](std::uint64_t v) { s.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+	const auto write_i64 = [&s](std::int64_t v) { s.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+	// deduplicate names, events of one call site share the same string view
+	std::vector<std::string_view> names;
+	const auto name_index = [&names](std::string_view name)
+	{
+		const auto it = std::find(names.begin(), names.end(), name);
+		if (it != names.end())
+			return static_cast<std::uint32_t>(it - names.begin());
+		names.push_back(name);
+		return static_cast<std::uint32_t>(names.size() - 1);
+	};
+	std::vector<const thread_buffer*> buffers;
+	for (const std::unique_ptr<thread_buffer>& b : m_buffers)
+	{
+		if (b->owner != buffer_owner::none)
+			buffers.push_back(b.get());
+	}
+	std::vector<std::vector<std::uint32_t>> event_names(buffers.size());
+	std::vector<std::uint32_t> thread_names(buffers.size(), ~std::uint32_t{0});
+	for (std::size_t t = 0; t < buffers.size(); ++t)
+	{
+		const thread_buffer& b = *buffers[t];
+		if (!b.name.empty())
+			thread_names[t] = name_index(b.name);
+		const std::size_t count = session_count(b);
+		event_names[t].reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+			event_names[t].push_back(name_index(b.events[i].name));
+	}
+	s.write("SWTRACE1", 8);
+	write_u32(static_cast<std::uint32_t>(names.size()));
+	for (const std::string_view& name : names)
+	{
+		write_u32(static_cast<std::uint32_t>(name.size()));
+		s.write(name.data(), static_cast<std::streamsize>(name.size()));
+	}
+	write_u32(static_cast<std::uint32_t>(buffers.size()));
+	for (std::size_t t = 0; t < buffers.size(); ++t)
+	{
+		const thread_buffer& b = *buffers[t];
+		write_u32(b.id);
+		write_u32(thread_names[t]);
+		write_u64(event_names[t].empty() ? 0 : b.dropped.load(std::memory_order_relaxed));
+		write_u32(static_cast<std::uint32_t>(event_names[t].size()));
+		for (std::size_t i = 0; i < event_names[t].size(); ++i)
+		{
+			write_u32(event_names[t][i]);
+			write_i64(b.events[i].begin_ns);
+			write_i64(b.events[i].duration_ns);
+		}
+	}
+	s.flush();
+}
+
+inline sw::trace_session::thread_guard::~thread_guard()
+{
+	thread_state& state = local_state();
+	if (state.buffer != nullptr)
+		instance().detach_thread(state.buffer);
+	state.buffer = nullptr;
+	state.detached = true;
+}
+
+inline sw::trace_session::thread_state& sw::trace_session::local_state() noexcept
+{
+	thread_local thread_state state;
+	return state;
+}
+
+inline sw::trace_session::thread_buffer* sw::trace_session::local_buffer()
+{
+	thread_state& state = local_state();
+	if (state.buffer == nullptr && !state.detached)
+		state.buffer = attach_thread();
+	return state.buffer;
+}
+
+inline sw::trace_session::thread_buffer* sw::trace_session::attach_thread()
+{
+	thread_local thread_guard guard;
+	static_cast<void>(guard);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	thread_buffer* b = nullptr;
+	for (const std::unique_ptr<thread_buffer>& free : m_buffers)
+	{
+		if (free->owner == buffer_owner::none)
+		{
+			b = free.get();
+			break;
+		}
+	}
+	if (b == nullptr)
+	{
+		std::unique_ptr<thread_buffer> fresh(new thread_buffer());
+		fresh->events.reset(new trace_event[events_per_thread]);
+		b = fresh.get();
+		m_buffers.push_back(std::move(fresh));
+	}
+	// a recycled buffer starts over for its new thread
+	b->id = m_next_id++;
+	b->name.clear();
+	b->owner = buffer_owner::thread;
+	b->state.store(std::uint64_t{m_generation.load(std::memory_order_relaxed)} << 32, std::memory_order_relaxed);
+	b->dropped.store(0, std::memory_order_relaxed);
+	return b;
+}
+
+inline void sw::trace_session::detach_thread(thread_buffer* b)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	// a buffer without events can be handed out right away
+	b->owner = session_count(*b) != 0 || !b->name.empty() ? buffer_owner::exited : buffer_owner::none;
+}
+
+inline std::size_t sw::trace_session::session_count(const thread_buffer& b) const noexcept
+{
+	if (b.owner == buffer_owner::none)
+		return 0;
+	const std::uint64_t state = b.state.load(std::memory_order_acquire);
+	return (state >> 32) == m_generation.load(std::memory_order_relaxed) ? static_cast<std::size_t>(state & 0xffffffffu) : 0;
+}
+
+inline void sw::trace_session::write_microseconds(std::string& out, std::int64_t ns)
+{
+	// fixed point with nanosecond precision, %g would lose digits of large timestamps
+	if (ns < 0)
+	{
+		out += '-';
+		ns = -ns;
+	}
+	out += std::to_string(ns / 1000);
+	const int fraction = static_cast<int>(ns % 1000);
+	out += '.';
+	out += static_cast<char>('0' + fraction / 100);
+	out += static_cast<char>('0' + fraction / 10 % 10);
+	out += static_cast<char>('0' + fraction % 10);
+}
+
+#endif
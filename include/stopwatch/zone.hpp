@@ -0,0 +1,390 @@
+#ifndef _STOPWATCH_ZONE_HPP_
+#define _STOPWATCH_ZONE_HPP_
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stopwatch/common.hpp>
+#include <stopwatch/cpu_clock.hpp>
+#include <stopwatch/registry.hpp>
+#include <stopwatch/stopwatch.hpp>
+
+namespace sw
+{
+	// node of a call tree, identified by the zone id and its path from the root
+	struct call_tree_node
+	{
+		timer_id zone;
+		std::uint32_t parent;
+		std::uint32_t first_child;
+		std::uint32_t next_sibling;
+		std::uint64_t calls;
+		std::chrono::nanoseconds inclusive;
+	};
+
+	/*
+		Call tree of nested zones. Nodes live in a single vector and are linked by index; entering a zone looks
+		up the child of the current node by zone id and only allocates the first time a call path is seen.
+		Zone names are resolved through timer_registry when printing.
+	*/
+	class call_tree
+	{
+	public:
+		static constexpr std::uint32_t root = 0;
+		static constexpr std::uint32_t npos = ~std::uint32_t{0};
+		// zone id of the root node, distinct from every registered id and from the overflow id
+		static constexpr timer_id root_zone = ~timer_id{0};
+
+		/**
+			* @brief Creates an empty call tree.
+			* @param reserve_nodes	Number of nodes to preallocate.
+		*/
+		explicit call_tree(std::size_t reserve_nodes = 256);
+		/**
+			* @brief Enters a zone below the current node, adding a node if the call path is new.
+			* @param zone	Zone id.
+			* @return		Index of the entered node.
+		*/
+		std::uint32_t enter(timer_id zone);
+		/**
+			* @brief Leaves a node entered with enter() and adds a call with the given duration.
+			* @param node	Node index returned by enter().
+			* @param d		Duration of the call.
+		*/
+		void exit(std::uint32_t node, std::chrono::nanoseconds d) noexcept;
+		/**
+			* @brief Adds the calls and times of another tree, matching nodes by call path.
+			* @param other	Tree to merge, e.g. the tree of another thread.
+		*/
+		void merge(const call_tree& other);
+		/**
+			* @brief Removes all nodes. Must not be called while zones are open.
+		*/
+		void reset();
+		/// Returns all nodes, index 0 is the root.
+		const std::vector<call_tree_node>& nodes() const noexcept { return m_nodes; }
+		/**
+			* @brief Returns the time spent in a node minus the time spent in its children.
+			* @param node	Node index.
+			* @return		Exclusive time.
+		*/
+		std::chrono::nanoseconds exclusive(std::uint32_t node) const noexcept;
+		/**
+			* @brief Prints the tree indented by depth, siblings ordered by inclusive time.
+			* @tparam duration_type	Duration type for printing times.
+		*/
+		template <typename ostrm, typename duration_type = sw::microseconds_d>
+		void print_tree(ostrm& s) const;
+		/**
+			* @brief Prints zones ordered by exclusive time, summed over all call paths of a zone.
+			* @tparam duration_type	Duration type for printing times.
+			* @param max_rows		Maximum number of printed zones.
+		*/
+		template <typename ostrm, typename duration_type = sw::microseconds_d>
+		void print_flat(ostrm& s, std::size_t max_rows = 20) const;
+
+	private:
+		std::uint32_t find_or_add_child(std::uint32_t parent, timer_id zone);
+		void merge_children(const call_tree& other, std::uint32_t other_node, std::uint32_t node);
+		template <typename ostrm, typename duration_type>
+		void print_node(ostrm& s, std::uint32_t node, std::size_t depth) const;
+
+		std::vector<call_tree_node> m_nodes;
+		std::uint32_t m_current;
+	};
+
+	inline namespace STOPWATCH_ABI_NAMESPACE
+	{
+		/*
+			Scoped zone: enters a node of the calling thread's call tree on construction and records its elapsed time on destruction.
+			Each thread has its own tree per clock type, merged into a process-wide tree of exited threads at thread exit.
+			Zones opened after that, e.g. in destructors of later thread_local objects, record nothing.
+		*/
+		template <typename clock_type>
+		class basic_zone
+		{
+		public:
+			using clock_t = clock_type;
+			using stopwatch_t = basic_stopwatch<clock_t, std::chrono::nanoseconds, true, false>;
+
+			/**
+				* @brief Enters the zone and starts timing.
+				* @param zone	Zone id from timer_registry::register_timer().
+			*/
+			explicit basic_zone(timer_id zone) : m_tree(stopwatch_enabled ? local_tree() : nullptr), m_node(m_tree ? m_tree->enter(zone) : call_tree::root), m_stopwatch() {}
+			basic_zone(const basic_zone&) = delete;
+			basic_zone& operator=(const basic_zone&) = delete;
+			/// Destructor. Stops timing and leaves the zone.
+			~basic_zone()
+			{
+				if constexpr (stopwatch_enabled)
+				{
+					if (m_tree == nullptr)
+						return;
+					m_stopwatch.stop();
+					m_tree->exit(m_node, m_stopwatch.elapsed_clock());
+				}
+			}
+			/**
+				* @brief Returns the calling thread's call tree for zones of this clock type.
+				* @return Call tree, or nullptr once it was merged into the tree of exited threads at thread exit.
+			*/
+			static call_tree* thread_tree() { return local_tree(); }
+			/**
+				* @brief Merges the trees of all exited threads and the calling thread's tree.
+				*		 Trees of other running threads are not included, they are merged when those threads exit.
+				* @return Merged call tree.
+			*/
+			static call_tree merged_tree();
+
+		private:
+			// tree of the calling thread; trivially destructible, so it stays valid until the thread is gone
+			struct thread_state
+			{
+				call_tree* tree = nullptr;
+				bool detached = false;	// set once the thread's tree was merged into the tree of exited threads
+			};
+			// merges the calling thread's tree at thread exit
+			struct thread_guard
+			{
+				~thread_guard();
+			};
+			struct exited_trees
+			{
+				std::mutex mutex;
+				call_tree tree;
+			};
+
+			static thread_state& local_state() noexcept;
+			// returns nullptr once the calling thread's tree was merged
+			static call_tree* local_tree();
+			static exited_trees& exited();
+
+			call_tree* m_tree;
+			std::uint32_t m_node;
+			stopwatch_t m_stopwatch;
+		};
+	}
+
+	using hres_zone = basic_zone<std::chrono::high_resolution_clock>;
+	using sys_zone 	= basic_zone<std::chrono::system_clock>;
+	using cpu_zone 	= basic_zone<cpu_clock>;
+	using tsc_zone 	= basic_zone<tsc_clock>;
+}
+
+#if defined(STOPWATCH_DISABLE)
+	#define STOPWATCH_ZONE_AS(zone_type, name) static_cast<void>(0)
+#else
+	// opens a zone for the rest of the enclosing scope; the name is registered only once
+	#define STOPWATCH_ZONE_AS(zone_type, name) \
+		static const ::sw::timer_id STOPWATCH_CONCAT(sw_zone_id_, __LINE__) = ::sw::timer_registry::instance().register_timer(name); \
+		zone_type STOPWATCH_CONCAT(sw_zone_, __LINE__)(STOPWATCH_CONCAT(sw_zone_id_, __LINE__))
+#endif
+#define STOPWATCH_ZONE(name) STOPWATCH_ZONE_AS(::sw::hres_zone, name)
+
+// --- implementation ---
+
+inline sw::call_tree::call_tree(std::size_t reserve_nodes) :
+	m_nodes(),
+	m_current(root)
+{
+	m_nodes.reserve(std::max<std::size_t>(reserve_nodes, 1));
+	reset();
+}
+
+inline std::uint32_t sw::call_tree::enter(timer_id zone)
+{
+	m_current = find_or_add_child(m_current, zone);
+	return m_current;
+}
+
+inline void sw::call_tree::exit(std::uint32_t node, std::chrono::nanoseconds d) noexcept
+{
+	call_tree_node& n = m_nodes[node];
+	++n.calls;
+	n.inclusive += d;
+	m_current = n.parent;
+}
+
+inline void sw::call_tree::merge(const call_tree& other)
+{
+	merge_children(other, root, root);
+}
+
+inline void sw::call_tree::reset()
+{
+	m_nodes.clear();
+	m_nodes.push_back(call_tree_node{root_zone, npos, npos, npos, 0, std::chrono::nanoseconds::zero()});
+	m_current = root;
+}
+
+inline std::chrono::nanoseconds sw::call_tree::exclusive(std::uint32_t node) const noexcept
+{
+	std::chrono::nanoseconds children = std::chrono::nanoseconds::zero();
+	for (std::uint32_t c = m_nodes[node].first_child; c != npos; c = m_nodes[c].next_sibling)
+		children += m_nodes[c].inclusive;
+	return std::max(m_nodes[node].inclusive - children, std::chrono::nanoseconds::zero());
+}
+
+template <typename ostrm, typename duration_type>
+inline void sw::call_tree::print_tree(ostrm& s) const
+{
+	print_node<ostrm, duration_type>(s, root, 0);
+	s.flush();
+}
+
+template <typename ostrm, typename duration_type>
+inline void sw::call_tree::print_flat(ostrm& s, std::size_t max_rows) const
+{
+	struct row
+	{
+		timer_id zone;
+		std::uint64_t calls;
+		std::chrono::nanoseconds exclusive;
+	};
+	std::vector<row> rows;
+	std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+	for (std::uint32_t i = 1; i < m_nodes.size(); ++i)
+	{
+		const std::chrono::nanoseconds excl = exclusive(i);
+		total += excl;
+		const auto it = std::find_if(rows.begin(), rows.end(), [&](const row& r) { return r.zone == m_nodes[i].zone; });
+		if (it == rows.end())
+			rows.push_back(row{m_nodes[i].zone, m_nodes[i].calls, excl});
+		else
+		{
+			it->calls += m_nodes[i].calls;
+			it->exclusive += excl;
+		}
+	}
+	std::sort(rows.begin(), rows.end(), [](const row& a, const row& b) { return a.exclusive > b.exclusive; });
+	rows.resize(std::min(rows.size(), max_rows));
+	char buffer[sw::max_duration_str_length];
+	for (const row& r : rows)
+	{
+		const char* const end = sw::format_duration(buffer, as<duration_type>(r.exclusive));
+		const double percent = total.count() > 0 ? 100.0 * static_cast<double>(r.exclusive.count()) / static_cast<double>(total.count()) : 0.0;
+		s << timer_registry::instance().name(r.zone) << ": exclusive " << std::string_view(buffer, static_cast<std::size_t>(end - buffer))
+		  << " (" << percent << " %), calls " << r.calls << '\n';
+	}
+	s.flush();
+}
+
+inline std::uint32_t sw::call_tree::find_or_add_child(std::uint32_t parent, timer_id zone)
+{
+	std::uint32_t last = npos;
+	for (std::uint32_t c = m_nodes[parent].first_child; c != npos; c = m_nodes[c].next_sibling)
+	{
+		if (m_nodes[c].zone == zone)
+			return c;
+		last = c;
+	}
+	// new call path
+	const std::uint32_t index = static_cast<std::uint32_t>(m_nodes.size());
+	m_nodes.push_back(call_tree_node{zone, parent, npos, npos, 0, std::chrono::nanoseconds::zero()});
+	if (last == npos)
+		m_nodes[parent].first_child = index;
+	else
+		m_nodes[last].next_sibling = index;
+	return index;
+}
+
+inline void sw::call_tree::merge_children(const call_tree& other, std::uint32_t other_node, std::uint32_t node)
+{
+	for (std::uint32_t c = other.m_nodes[other_node].first_child; c != npos; c = other.m_nodes[c].next_sibling)
+	{
+		const std::uint32_t target = find_or_add_child(node, other.m_nodes[c].zone);
+		m_nodes[target].calls += other.m_nodes[c].calls;
+		m_nodes[target].inclusive += other.m_nodes[c].inclusive;
+		merge_children(other, c, target);
+	}
+}
+
+template <typename ostrm, typename duration_type>
+inline void sw::call_tree::print_node(ostrm& s, std::uint32_t node, std::size_t depth) const
+{
+	if (node != root)
+	{
+		char inclusive_buffer[sw::max_duration_str_length];
+		char exclusive_buffer[sw::max_duration_str_length];
+		const char* const inclusive_end = sw::format_duration(inclusive_buffer, as<duration_type>(m_nodes[node].inclusive));
+		const char* const exclusive_end = sw::format_duration(exclusive_buffer, as<duration_type>(exclusive(node)));
+		for (std::size_t i = 1; i < depth; ++i)
+			s << "  ";
+		s << timer_registry::instance().name(m_nodes[node].zone) << ": calls " << m_nodes[node].calls
+		  << ", inclusive " << std::string_view(inclusive_buffer, static_cast<std::size_t>(inclusive_end - inclusive_buffer))
+		  << ", exclusive " << std::string_view(exclusive_buffer, static_cast<std::size_t>(exclusive_end - exclusive_buffer)) << '\n';
+	}
+	std::vector<std::uint32_t> children;
+	for (std::uint32_t c = m_nodes[node].first_child; c != npos; c = m_nodes[c].next_sibling)
+		children.push_back(c);
+	std::sort(children.begin(), children.end(), [this](std::uint32_t a, std::uint32_t b) { return m_nodes[a].inclusive > m_nodes[b].inclusive; });
+	for (const std::uint32_t c : children)
+		print_node<ostrm, duration_type>(s, c, depth + 1);
+}
+
+template <typename clock_type>
+inline sw::call_tree sw::basic_zone<clock_type>::merged_tree()
+{
+	exited_trees& e = exited();
+	call_tree merged;
+	{
+		const std::lock_guard<std::mutex> lock(e.mutex);
+		merged.merge(e.tree);
+	}
+	if (const call_tree* const t = local_tree())
+		merged.merge(*t);
+	return merged;
+}
+
+template <typename clock_type>
+inline sw::basic_zone<clock_type>::thread_guard::~thread_guard()
+{
+	thread_state& state = local_state();
+	if (state.tree != nullptr)
+	{
+		exited_trees& e = exited();
+		{
+			const std::lock_guard<std::mutex> lock(e.mutex);
+			e.tree.merge(*state.tree);
+		}
+		delete state.tree;
+	}
+	state.tree = nullptr;
+	state.detached = true;
+}
+
+template <typename clock_type>
+inline typename sw::basic_zone<clock_type>::thread_state& sw::basic_zone<clock_type>::local_state() noexcept
+{
+	thread_local thread_state state;
+	return state;
+}
+
+template <typename clock_type>
+inline sw::call_tree* sw::basic_zone<clock_type>::local_tree()
+{
+	thread_state& state = local_state();
+	if (state.tree == nullptr && !state.detached)
+	{
+		thread_local thread_guard guard;
+		static_cast<void>(guard);
+		state.tree = new call_tree();
+	}
+	return state.tree;
+}
+
+template <typename clock_type>
+inline typename sw::basic_zone<clock_type>::exited_trees& sw::basic_zone<clock_type>::exited()
+{
+	// never destroyed, threads may exit after static destruction began
+	static exited_trees* const e = new exited_trees();
+	return *e;
+}
+
+#endif
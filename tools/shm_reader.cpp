@@ -0,0 +1,92 @@
+// Attaches to the metrics file of a process using sw::shm_exporter and prints calls, totals and rates of its
+// timers periodically until the file disappears.
+// Usage: stopwatch_shm_reader <pid | file name | path> [interval ms] [--once]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <stopwatch/shm_export.hpp>
+
+namespace
+{
+    void print(const sw::shm_metrics& current, const sw::shm_metrics* previous)
+    {
+        std::cout << "pid " << current.pid << ", publish " << current.publish_count << ", threads " << current.report.thread_count;
+        if (current.torn_slots != 0)
+            std::cout << ", torn slots " << current.torn_slots;
+        std::cout << '\n';
+        // rates over the time between the two publishes
+        std::unordered_map<std::string_view, const sw::timer_stats*> before;
+        double seconds = 0.0;
+        if (previous != nullptr)
+        {
+            for (const sw::timer_stats& t : previous->report.timers)
+                before.emplace(t.name, &t);
+            seconds = sw::as<sw::seconds_d>(current.published - previous->published).count();
+        }
+        char buffer[sw::max_duration_str_length];
+        const auto duration = [&](std::chrono::nanoseconds d)
+        {
+            return std::string_view(buffer, static_cast<std::size_t>(sw::format_duration(buffer, sw::as<sw::microseconds_d>(d)) - buffer));
+        };
+        for (const sw::timer_stats& t : current.report.timers)
+        {
+            std::cout << "  " << t.name << ": calls " << t.count << ", total " << duration(t.total) << ", mean " << duration(t.mean());
+            const auto it = before.find(t.name);
+            if (seconds > 0.0 && it != before.end())
+            {
+                const double calls = static_cast<double>(t.count - it->second->count) / seconds;
+                const double busy = sw::as<sw::seconds_d>(t.total - it->second->total).count() / seconds;
+                std::cout << ", " << calls << " calls/s, busy " << 100.0 * busy << " %";
+            }
+            std::cout << '\n';
+        }
+        std::cout.flush();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: stopwatch_shm_reader <pid | file name | path> [interval ms] [--once]\n";
+        return 2;
+    }
+    std::string name = argv[1];
+    if (std::all_of(name.begin(), name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+        name = "stopwatch." + name;
+    const std::chrono::milliseconds interval(argc > 2 && std::strcmp(argv[2], "--once") != 0 ? std::atoi(argv[2]) : 1000);
+    const bool once = std::strcmp(argv[argc - 1], "--once") == 0;
+
+    sw::shm_reader reader;
+    if (!reader.attach(name))
+    {
+        std::cerr << "cannot attach to " << name << " in " STOPWATCH_SHM_DIR "\n";
+        return 1;
+    }
+    sw::shm_metrics previous;
+    sw::shm_metrics current;
+    bool has_previous = false;
+    for (;;)
+    {
+        reader.read(current);
+        print(current, has_previous ? &previous : nullptr);
+        if (once)
+            return 0;
+        // the timer names of a read point into the mapping, which stays valid while attached
+        std::swap(previous, current);
+        has_previous = true;
+        std::this_thread::sleep_for(interval);
+        const std::string path = name.front() == '/' ? name : STOPWATCH_SHM_DIR "/" + name;
+        if (::access(path.c_str(), F_OK) != 0)
+        {
+            std::cout << "exporter exited\n";
+            return 0;
+        }
+    }
+}